@@ -0,0 +1,101 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _BUS_H_
+#define _BUS_H_
+
+#include <Arduino.h>
+#include <DS18B20.h>
+#include <Wire.h>
+
+#define BUS_MAX_I2C         2
+#define BUS_MAX_ONEWIRE     4
+
+#define I2C_CLOCK_DEFAULT   100000
+#define I2C_CLOCK_MAX       400000
+
+/*
+ * Buses are shared by all sensors attached to the same pins. A sensor wraps
+ * its transfers in acquire()/release(), which keeps track of how long the
+ * bus was busy.
+ */
+class Bus {
+protected:
+    uint32_t busy_us = 0;
+    uint32_t start_us = 0;
+
+public:
+    void release() { busy_us += micros() - start_us; }
+    uint32_t get_busy_us() { return busy_us; }
+};
+
+class I2CBus : public Bus {
+private:
+    int8_t sda = -1;
+    int8_t scl = -1;
+    uint32_t clock = 0;
+    uint8_t probed[16] = {0};
+    uint8_t present[16] = {0};
+
+    /* there is only one Wire, it is moved to the pins of the bus in use */
+    static I2CBus *active;
+
+    friend class BusManager;
+
+public:
+    TwoWire *acquire();
+    bool has_device(uint8_t);
+
+    int8_t get_sda() { return sda; }
+    int8_t get_scl() { return scl; }
+};
+
+class OneWireBus : public Bus {
+private:
+    int8_t pin = -1;
+    bool searched = false;
+    DS18B20 *ds = nullptr;
+    uint8_t ds_storage[sizeof(DS18B20)] __attribute__ ((aligned(4)));
+
+    void begin(bool search);
+
+    friend class BusManager;
+
+public:
+    DS18B20 *acquire() {
+        start_us = micros();
+        return ds;
+    }
+
+    int8_t get_pin() { return pin; }
+};
+
+class BusManager {
+private:
+    I2CBus i2c_buses[BUS_MAX_I2C];
+    uint8_t num_i2c = 0;
+    OneWireBus onewire_buses[BUS_MAX_ONEWIRE];
+    uint8_t num_onewire = 0;
+
+public:
+    /* clock 0 keeps the current (or default) clock, the slowest one wins */
+    I2CBus *i2c(int8_t sda, int8_t scl, uint32_t clock = 0);
+    /*
+     * search false skips the ROM search, see DS18B20::restoreBus(). The
+     * search is done once the bus is asked for with search set, even if it
+     * was set up without.
+     */
+    OneWireBus *onewire(int8_t pin, bool search = true);
+
+    uint32_t get_i2c_busy_us();
+    uint32_t get_onewire_busy_us();
+    void print_stats();
+
+    BusManager() {}
+    ~BusManager() {}
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _CHANGE_DETECTOR_H_
+#define _CHANGE_DETECTOR_H_
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#include "rtcmem.h"
+#include "sample_buffer.h"
+
+#define CHANGE_MAX_FIELDS   SAMPLE_BUFFER_MAX_VALUES
+
+/* a policy set to NAN is not used */
+struct change_policy {
+    float delta;            /* absolute change against the reported value */
+    float percent;          /* change relative to the reported value */
+    float rate;             /* change from one wake to the next */
+    float level;            /* crossing level in either direction ... */
+    float hysteresis;       /* ... by more than half the hysteresis */
+};
+
+#define CHANGE_INIT     0x01
+#define CHANGE_PENDING  0x02
+
+/* wakes a change waits for its upload before it is given up */
+#define CHANGE_MAX_PENDING_WAKES    6
+
+/*
+ * Followed by the reported values, num_fields per point, and the values of
+ * the previous wake if any field has a rate policy.
+ */
+struct change_rtc_data {
+    uint32_t above;         /* per point and field, value above level */
+    uint16_t silence;       /* wakes since the last upload */
+    uint8_t flags;
+    uint8_t pending_wakes;  /* wakes the change waited for its upload */
+} __attribute__((aligned(4)));
+
+/* RTC memory words of a change record, at most, i.e. with a rate policy */
+#define CHANGE_RTCMEM_WORDS(fields, points) \
+    RTCMEM_RECORD_WORDS(sizeof(struct change_rtc_data) + \
+                        2 * (fields) * (points) * sizeof(float))
+
+/*
+ * Decides from the raw values of a sensor whether they are worth going
+ * online for. Policies are set per field in the sensor config, e.g.
+ *
+ *   "change": { "temperature": { "delta": 0.3, "rate": 0.5 },
+ *               "humidity": { "level": 80, "hysteresis": 4 } },
+ *   "heartbeat": 24
+ *
+ * Any policy that triggers marks the whole sensor as changed. heartbeat
+ * forces an upload after that many wakes without one. A field may also set
+ * the "resolution" buffered samples are kept with.
+ */
+class ChangeDetector {
+private:
+    struct change_policy policy[CHANGE_MAX_FIELDS];
+    float resolution[CHANGE_MAX_FIELDS];
+    uint8_t num_fields = 0;
+    uint8_t num_points = 0;
+    uint16_t heartbeat_wakes = 0;
+    bool use_rate = false;
+    struct change_rtc_data *rtc = nullptr;
+    float *reported_values = nullptr;
+    float *last_values = nullptr;
+
+public:
+    /* delta and res are used if the config of field name has none */
+    bool add_field(const JsonVariant &, const char *name, float delta,
+                   float res);
+    void begin(const JsonVariant &, uint8_t points);
+
+    uint8_t get_num_fields() { return num_fields; }
+
+    /* fixed point values for the sample buffer */
+    int32_t quantise(uint8_t field, float v);
+    float value(uint8_t field, int32_t q);
+
+    /* values of the current wake, true if they trigger an upload */
+    bool check(uint8_t point, const float *values, uint8_t count);
+    /* counts this wake, true once no upload happened for too long */
+    bool heartbeat();
+
+    /* a change waits for its upload */
+    bool pending() { return rtc && (rtc->flags & CHANGE_PENDING); }
+    void set_pending();
+    /* counts a wake of a pending change, false once it was given up */
+    bool age_pending();
+
+    void store(uint8_t point, const float *values, uint8_t count);
+    const float *reported(uint8_t point);
+    void published();
+};
+
+#endif
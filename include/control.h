@@ -10,9 +10,36 @@
 #include <ESP8266WiFi.h>
 #include <IPAddress.h>
 #include <include/WiFiState.h>
-#include <InfluxDbClient.h>
 
+#include "line_protocol.h"
 #include "sensor.h"
+#include "tls_session.h"
+#include "upload_queue.h"
+
+struct control_rtc_data {
+    uint32_t go_online;
+    uint32_t reboot_count;
+    uint32_t sample_time;
+};
+
+/* last working network config, connecting with it skips DHCP and scanning */
+struct netcfg_rtc_data {
+    uint32_t magic;
+    uint32_t ip_addr;
+    uint32_t netmask;
+    uint32_t gateway;
+    uint32_t namesrv;
+    uint8_t bssid[6];
+    uint8_t chan;
+};
+
+/* ways to get online, tried in this order */
+enum connect_stage : uint8_t {
+    CONNECT_RESUME,     /* WiFi state saved by WiFi.shutdown() */
+    CONNECT_NETCFG,     /* static IP, BSSID and channel from NetCfg */
+    CONNECT_SCAN,       /* scan and DHCP */
+    CONNECT_STAGES,
+};
 
 class NetCfg {
 private:
@@ -53,7 +80,7 @@ private:
     const char *influx_org = nullptr;
     const char *influx_bucket = nullptr;
     const char *influx_token = nullptr;
-    uint32_t   influx_retry = 0;
+    bool influx_gzip = false;
 
     String device_name;
 
@@ -77,21 +104,40 @@ private:
     WiFiClient *wifi_client;
     BearSSL::X509List *_cert = nullptr;
     HTTPClient *https = nullptr;
+    TlsSessionCache tls_sessions;
 
     SensorManager *sensor_manager = nullptr;
-    InfluxDBClient *influx = nullptr;
-
+    UploadQueue queue;
+
+    /* kept alive for all writes of a wake */
+    BearSSL::WiFiClientSecure *influx_client = nullptr;
+    HTTPClient *influx_http = nullptr;
+    BearSSL::Session influx_session;
+    String influx_host;
+    String influx_write_url;
+    String influx_auth;
+    bool influx_mfln = false;
+    bool influx_connected = false;
+
+    struct control_rtc_data *rtc = nullptr;
+    WiFiState *wifi_state = nullptr;
     uint32_t connect_time;
+    uint32_t connect_stage_ms[CONNECT_STAGES] = {0};
+    uint8_t connected_by = CONNECT_STAGES;
     uint32_t sample_time;
     bool valid_net_cfg;
 
 protected:
-    void publish_trace_data();
+    void publish_trace_data(LineProtocol &);
+    bool influx_setup();
+    size_t send_lines(const char *, size_t);
     void publish_data();
     void read_global_config();
     void read_config();
     bool OTA();
     bool update_config(const char *);
+    bool wait_connected(uint32_t);
+    bool connect(enum connect_stage);
     void go_online();
     void set_clock();
     void deep_sleep();
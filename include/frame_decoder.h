@@ -0,0 +1,169 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _FRAME_DECODER_H_
+#define _FRAME_DECODER_H_
+
+#include <array>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Framing for UART sensors which send fixed or length prefixed binary frames.
+ * A decoder is put together from three policies:
+ *
+ *   Sync      - SyncBytes<...>, the bytes every frame starts with
+ *   Length    - header_size bytes of the frame (sync included) are needed
+ *               before length(frame) can tell the total frame size
+ *   Checksum  - valid(frame, len) checks a complete frame
+ *
+ * e.g. a Plantower PMS5003 would be
+ *
+ *   FrameDecoder<SyncBytes<0x42, 0x4d>, LengthField<2, 4>, Sum16BE, 32>
+ *
+ * The frame is kept in a std::array of MaxLen bytes, nothing is allocated.
+ */
+
+template <uint8_t... Bytes>
+struct SyncBytes {
+    static constexpr size_t size = sizeof...(Bytes);
+    static constexpr uint8_t bytes[size] = {Bytes...};
+};
+
+template <uint8_t... Bytes>
+constexpr uint8_t SyncBytes<Bytes...>::bytes[];
+
+template <size_t N>
+struct FixedLength {
+    static constexpr size_t header_size = 0;
+    static size_t length(const uint8_t *) { return N; }
+};
+
+/* big endian 16 bit length at Offset, counting everything after it */
+template <size_t Offset, size_t Extra>
+struct LengthField {
+    static constexpr size_t header_size = Offset + 2;
+    static size_t length(const uint8_t *frame) {
+        return ((frame[Offset] << 8) | frame[Offset + 1]) + Extra;
+    }
+};
+
+/* all bytes including the checksum add up to 0 */
+struct Sum8 {
+    static bool valid(const uint8_t *frame, size_t len) {
+        uint8_t sum = 0;
+
+        for (size_t i = 0; i < len; i++)
+            sum += frame[i];
+
+        return sum == 0;
+    }
+};
+
+/* the last two bytes are the big endian sum of all others */
+struct Sum16BE {
+    static bool valid(const uint8_t *frame, size_t len) {
+        uint16_t sum = 0;
+
+        for (size_t i = 0; i < len - 2; i++)
+            sum += frame[i];
+
+        return sum == ((frame[len - 2] << 8) | frame[len - 1]);
+    }
+};
+
+enum FrameResult : uint8_t {
+    FRAME_NONE,         /* frame still incomplete */
+    FRAME_DONE,         /* complete frame with valid checksum in data() */
+    FRAME_BAD_LENGTH,   /* length field out of range, frame dropped */
+    FRAME_BAD_CHECKSUM, /* frame dropped */
+};
+
+template <typename Sync, typename Length, typename Checksum, size_t MaxLen>
+class FrameDecoder {
+    static_assert(Sync::size > 0, "frames need sync bytes");
+    static_assert(Sync::size <= MaxLen && Length::header_size <= MaxLen,
+                  "MaxLen too small for the frame header");
+
+private:
+    std::array<uint8_t, MaxLen> frame;
+    size_t pos = 0;
+    size_t len = 0;
+    bool have_len = false;  /* len is the header size until then */
+    uint8_t resyncs = 0;
+
+    FrameResult sync(uint8_t c) {
+        if (c != Sync::bytes[pos]) {
+            if (pos && resyncs < UINT8_MAX)
+                resyncs++;
+            pos = 0;
+            if (c != Sync::bytes[0])
+                return FRAME_NONE;
+        }
+        frame[pos++] = c;
+        if (pos < Sync::size)
+            return FRAME_NONE;
+
+        have_len = false;
+        len = Length::header_size;
+        if (pos < len)
+            return FRAME_NONE;
+        return header();
+    }
+
+    FrameResult header() {
+        len = Length::length(frame.data());
+        have_len = true;
+        if (len > MaxLen || len < pos) {
+            reset();
+            return FRAME_BAD_LENGTH;
+        }
+        if (pos < len)
+            return FRAME_NONE;
+        return complete();
+    }
+
+    FrameResult complete() {
+        pos = 0;
+        if (!Checksum::valid(frame.data(), len))
+            return FRAME_BAD_CHECKSUM;
+        return FRAME_DONE;
+    }
+
+public:
+    /*
+     * Feed one received byte. While hunting for the sync bytes a mismatch
+     * restarts the search, so sync patterns must not overlap themselves
+     * beyond their first byte. The frame body is the common case and takes
+     * a single compare per byte.
+     */
+    FrameResult push(uint8_t c) {
+        if (pos < Sync::size)
+            return sync(c);
+
+        frame[pos++] = c;
+        if (pos < len)
+            return FRAME_NONE;
+        if (!have_len)
+            return header();
+        return complete();
+    }
+
+    void reset() {
+        pos = 0;
+        len = 0;
+        have_len = false;
+    }
+
+    /* only valid right after push() returned FRAME_DONE */
+    const uint8_t *data() const { return frame.data(); }
+    size_t size() const { return len; }
+
+    /* partial sync sequences thrown away so far */
+    uint8_t get_resyncs() const { return resyncs; }
+};
+
+#endif
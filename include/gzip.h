@@ -0,0 +1,33 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _GZIP_H_
+#define _GZIP_H_
+
+#include <Arduino.h>
+
+/* positions are kept as 16 bit, longer input is not compressed */
+#define GZIP_MAX_INPUT      UINT16_MAX
+/* hash table of 2 KB on the heap while compressing */
+#define GZIP_HASH_BITS      10
+
+/* enough for any input of len bytes, literals take at most 9 bits */
+#define GZIP_BOUND(len)     ((len) + (len) / 8 + 32)
+
+/*
+ * Single block deflate with the fixed Huffman codes, wrapped as gzip. The
+ * whole input is the window and matches are found through a hash of three
+ * bytes holding the last position only. That is no match for zlib, but line
+ * protocol repeats the same tags on every line and the last occurrence is
+ * usually the best match anyway.
+ *
+ * Returns the size written to out, 0 if the input is too long, memory is
+ * short or the result would not fit into out_size bytes.
+ */
+size_t gzip_compress(const uint8_t *in, size_t len, uint8_t *out,
+                     size_t out_size);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _LINE_PROTOCOL_H_
+#define _LINE_PROTOCOL_H_
+
+#include <Arduino.h>
+
+/* estimate per point when sizing the buffer, trace data is the longest */
+#define LINE_PROTOCOL_POINT_SIZE    256
+#define LINE_PROTOCOL_MAX_SIZE      8192
+/* escaped device, chip_id and firmware_version tags */
+#define LINE_PROTOCOL_PREFIX_SIZE   128
+
+/*
+ * InfluxDB line protocol written straight into one buffer which is allocated
+ * once. A point is written as
+ *
+ *   begin(measurement), tag()..., field()..., end(time)
+ *
+ * and every point gets the device tags set up by set_device() right after
+ * the measurement, those are escaped only once. A point which does not fit
+ * or has no fields is taken back by end() and counted as dropped. Floats are
+ * written with a fixed number of decimals, integers with the i suffix, like
+ * the InfluxDB client library did.
+ */
+class LineProtocol {
+private:
+    char *buf = nullptr;
+    size_t size = 0;
+    size_t len = 0;
+    size_t line_start = 0;
+    bool has_fields = false;
+    bool overflow = false;
+    uint16_t dropped = 0;
+    char prefix[LINE_PROTOCOL_PREFIX_SIZE];
+    uint8_t prefix_len = 0;
+
+    void put(char c);
+    void put(const char *s, size_t n);
+    void put_escaped(const char *s, const char *special);
+    void put_uint(uint64_t v, uint8_t digits = 1);
+
+public:
+    /* false if the buffer could not be allocated */
+    bool alloc(size_t size);
+    void set_device(const char *device, const char *chip_id,
+                    const char *version);
+
+    void begin(const char *measurement);
+    void tag(const char *key, const char *value);
+    void field(const char *key, float value, uint8_t decimals = 2);
+    void field_uint(const char *key, uint32_t value);
+    void end(uint32_t time_s);
+
+    const char *c_str() { return buf; }
+    size_t length() { return len; }
+    uint16_t get_dropped() { return dropped; }
+
+    LineProtocol() {}
+    ~LineProtocol() { free(buf); }
+    LineProtocol(const LineProtocol &) = delete;
+    LineProtocol &operator=(const LineProtocol &) = delete;
+};
+
+#endif
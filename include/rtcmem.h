@@ -0,0 +1,122 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _RTCMEM_H_
+#define _RTCMEM_H_
+
+#include <Arduino.h>
+
+#define RTCMEM_WORDS    128
+#define RTCMEM_MAGIC    0x52d1
+
+/* one per record type, never reuse a number, gaps are removed records */
+enum RtcMemTag : uint8_t {
+    RTCMEM_TAG_FREE = 0,
+    RTCMEM_TAG_CONTROL = 1,
+    RTCMEM_TAG_NET_CFG = 2,
+    RTCMEM_TAG_SENSOR_STATS = 3,
+    RTCMEM_TAG_BME280_CALIB = 6,
+    RTCMEM_TAG_DS18B20_ROMS = 8,
+    RTCMEM_TAG_SAMPLES = 11,
+    RTCMEM_TAG_CHANGE = 12,
+    RTCMEM_TAG_WIFI_STATE = 13,
+    RTCMEM_TAG_TLS_SESSIONS = 14,
+    RTCMEM_TAG_COUNT,
+};
+
+struct rtcmem_header {
+    uint16_t magic;
+    uint16_t used;          /* words in use after the header */
+    uint32_t version;       /* hash of the firmware version */
+    uint32_t crc;           /* over the used words */
+};
+
+struct rtcmem_record {
+    uint8_t tag;
+    uint8_t instance;
+    uint16_t words;         /* data words following this header */
+};
+
+static_assert(sizeof(struct rtcmem_header) == 12, "rtcmem_header changed");
+static_assert(sizeof(struct rtcmem_record) == 4, "rtcmem_record changed");
+
+/* words a record of size bytes takes, including its header */
+#define RTCMEM_RECORD_WORDS(size)   (1 + ((size) + 3) / 4)
+
+/*
+ * Word budget, the owners check their records against it at compile time.
+ * The sensors share RTCMEM_BUDGET_SENSORS, which has to hold the sensors of
+ * misc/templates/mapping.json.tmpl (see sensor.cpp). The sample buffer gets
+ * what is left, sample_buffer_words in the config is capped to that.
+ *
+ * The WiFi state saves a scan and DHCP each time the device goes online,
+ * the TLS session the key exchange of the handshake. With "wifi_resume" or
+ * "tls_resume" set to false in the config their words go to the sample
+ * buffer instead, which pays off once the device only goes online every few
+ * wakes.
+ */
+#define RTCMEM_BUDGET_HEADER        3
+#define RTCMEM_BUDGET_CONTROL       4
+#define RTCMEM_BUDGET_NET_CFG       8
+#define RTCMEM_BUDGET_SENSOR_STATS  12
+#define RTCMEM_BUDGET_WIFI_STATE    40
+#define RTCMEM_BUDGET_TLS_SESSIONS  25
+#define RTCMEM_BUDGET_SENSORS       24
+#define RTCMEM_BUDGET_SAMPLES       (RTCMEM_WORDS - RTCMEM_BUDGET_HEADER - \
+                                     RTCMEM_BUDGET_CONTROL - \
+                                     RTCMEM_BUDGET_NET_CFG - \
+                                     RTCMEM_BUDGET_SENSOR_STATS - \
+                                     RTCMEM_BUDGET_WIFI_STATE - \
+                                     RTCMEM_BUDGET_TLS_SESSIONS - \
+                                     RTCMEM_BUDGET_SENSORS)
+
+static_assert(RTCMEM_BUDGET_HEADER * 4 == sizeof(struct rtcmem_header),
+              "RTC memory header not in the budget");
+static_assert(RTCMEM_BUDGET_SAMPLES > 0, "RTC memory budget exceeded");
+
+/*
+ * The whole RTC user memory is read into RAM once per wake and written back
+ * once right before deep sleep. Within the image, records are identified by
+ * tag and instance and are allocated on first use, so nobody has to assign
+ * slots by hand. After a firmware update, a CRC mismatch or power on all
+ * records start out zeroed.
+ *
+ * Records which were not asked for during a wake are dropped on commit(), so
+ * everything that should survive must be requested on every wake.
+ */
+class RtcMem {
+private:
+    uint32_t image[RTCMEM_WORDS];
+    uint32_t requested[RTCMEM_WORDS / 32];
+    uint8_t next_instance[RTCMEM_TAG_COUNT];
+    bool loaded = false;
+
+    struct rtcmem_header *header() { return (struct rtcmem_header *)image; }
+    void reset();
+    void mark(uint16_t pos) { requested[pos / 32] |= 1u << (pos % 32); }
+    bool is_marked(uint16_t pos) { return requested[pos / 32] & (1u << (pos % 32)); }
+
+public:
+    void load();
+    void commit();
+
+    /* record tag/instance of size bytes, nullptr once the memory is full */
+    void *get(uint8_t tag, size_t size, uint8_t instance = 0);
+    /* a new instance of tag on every call, e.g. one per sensor */
+    void *alloc(uint8_t tag, size_t size);
+
+    /*
+     * For records whose size is only known later: reserve an instance,
+     * find() what was kept of it whatever its size and get() it with the
+     * right size once that is known.
+     */
+    uint8_t new_instance(uint8_t tag);
+    void *find(uint8_t tag, uint8_t instance, size_t &size);
+};
+
+extern RtcMem rtcmem;
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _SAMPLE_BUFFER_H_
+#define _SAMPLE_BUFFER_H_
+
+#include <Arduino.h>
+
+#include "rtcmem.h"
+
+/* values of one point, the DS18B20 publishes one point per probe */
+#define SAMPLE_BUFFER_MAX_VALUES    8
+/* sensor/point pairs whose values are delta encoded, others are absolute */
+#define SAMPLE_BUFFER_MAX_SERIES    24
+
+struct sample_buffer_header {
+    uint32_t clock_ms;      /* device time at the start of this wake */
+    uint32_t base_ms;       /* device time of the oldest sample */
+    uint16_t used;          /* bytes of samples */
+    uint16_t entries;
+};
+
+/* the share of the RTC memory budget left for samples, with all caches */
+#define SAMPLE_BUFFER_MAX_WORDS     (RTCMEM_BUDGET_SAMPLES - \
+        RTCMEM_RECORD_WORDS(sizeof(struct sample_buffer_header)))
+
+static_assert(SAMPLE_BUFFER_MAX_WORDS >= 8,
+              "RTC memory budget leaves no room for samples");
+
+/*
+ * A decoded entry. Values are quantised to the resolution of their field,
+ * those missing from mask were not measured.
+ */
+struct sample_entry {
+    uint8_t sensor;
+    uint8_t point;
+    uint8_t count;
+    uint8_t mask;
+    uint32_t age_s;
+    int32_t values[SAMPLE_BUFFER_MAX_VALUES];
+};
+
+struct sample_series {
+    uint8_t sensor;
+    uint8_t point;
+    int32_t last[SAMPLE_BUFFER_MAX_VALUES];
+};
+
+/*
+ * Samples of several wakes kept in RTC memory, so that the radio is only
+ * switched on once enough of them have been collected. There is no real time
+ * while offline, samples are stamped with the device time, which is the sum
+ * of awake and sleep times since the buffer was set up, and turned into real
+ * time stamps at upload. The deep sleep timer is only accurate to a few
+ * percent, so are the time stamps.
+ *
+ * Entries are packed into a byte stream:
+ *
+ *   sensor | SAMPLE_TIME | SAMPLE_MASK, point << 4 | count,
+ *   [time], [mask], value varints
+ *
+ * The first entry of a wake carries the time as the zig-zag varint of the
+ * change of the wake interval, one byte as long as the interval stays the
+ * same. Each value is the zig-zag varint of its difference to the previous
+ * value of the same field, point and sensor. Slowly changing values take one
+ * or two bytes. The stream is decoded from the start on every wake to find
+ * the previous values again.
+ */
+class SampleBuffer {
+private:
+    struct sample_buffer_header *hdr = nullptr;
+    uint8_t *data = nullptr;
+    uint16_t size = 0;
+
+    /* codec state, after begin() that of the end of the stream */
+    struct sample_series series[SAMPLE_BUFFER_MAX_SERIES];
+    uint8_t num_series = 0;
+    uint16_t pos = 0;
+    uint32_t time_s = 0;
+    uint32_t interval_s = 0;
+    bool timed = false;     /* this wake has its time in the stream */
+
+    void reset();
+    int32_t *find_series(uint8_t sensor, uint8_t point, int32_t *scratch);
+
+public:
+    bool begin(uint16_t words);
+    bool enabled() { return hdr; }
+
+    uint16_t get_used() { return hdr ? hdr->used : 0; }
+    uint16_t free_bytes() { return hdr ? size - hdr->used : 0; }
+    bool add(uint8_t sensor, uint8_t point, const int32_t *values,
+             uint8_t mask, uint8_t count);
+    bool too_old();
+    void clear();
+
+    /* entries in the order they were added, false after the last one */
+    void rewind();
+    bool next(struct sample_entry &);
+    uint16_t get_num_entries() { return hdr ? hdr->entries : 0; }
+
+    /* account for the time until the next wake */
+    void sleep(uint32_t sleep_s);
+};
+
+#endif
@@ -8,69 +8,150 @@
 #define _SENSOR_H_
 
 #include <ArduinoJson.h>
-#include <InfluxDbClient.h>
-#include <map>
-#include <list>
+#include <new>
+
+#include "bus.h"
+#include "change_detector.h"
+#include "line_protocol.h"
+#include "sample_buffer.h"
+#include "sensor_drivers.h"
+
+#ifndef SENSOR_MAX_SENSORS
+#define SENSOR_MAX_SENSORS 5
+#endif
 
 enum Sensor_State {
     SENSOR_NOT_INIT,
     SENSOR_INIT,
-    SENSOR_DONE_UPDATE,
-    SENSOR_DONE_NOUPDATE,
+    SENSOR_DONE,
 };
 
 class Sensor;
-class SensorFactory;
+class SensorManager;
+
+/* counted by the sensor itself during the current wake */
+struct sensor_counters {
+    uint16_t bytes_read;
+    uint8_t checksum_errors;    /* frames dropped for a bad checksum */
+    uint8_t resyncs;            /* lost frame sync / malformed telegrams */
+    uint8_t bus_errors;         /* failed bus transfers, UART overruns */
+};
+
+/*
+ * Per sensor statistics, accumulated in RTC memory over all wakes since the
+ * last upload. Counters saturate instead of wrapping.
+ */
+struct sensor_stats {
+    uint16_t latency_ms;        /* slowest start() to done */
+    uint8_t polls;              /* most sample() calls needed in one wake */
+    uint8_t checksum_errors;
+    uint8_t resyncs;
+    uint8_t bus_errors;
+    uint16_t bytes_read;
+};
+
+struct sensor_stats_rtc {
+    uint16_t wakes;
+    struct sensor_stats stats[SENSOR_MAX_SENSORS];
+} __attribute__((aligned(4)));
+
+/* create() constructs the sensor in place, size bytes aligned to align */
+struct sensor_driver {
+    const char *type;
+    size_t size;
+    size_t align;
+    Sensor *(*create)(JsonVariant &, SensorManager *, void *);
+};
 
 class SensorManager {
 private:
-    std::map<const char *, SensorFactory *> factories;
-    std::list<Sensor *> sensors;
+    Sensor *sensors[SENSOR_MAX_SENSORS];
+    /* sampling order, sensors sharing a bus next to each other */
+    uint8_t order[SENSOR_MAX_SENSORS];
+    BusManager buses;
     bool upload_request = false;
     bool done = false;
+    bool started = false;
+    uint32_t next_deadline = 0;
+    uint32_t start_time = 0;
 
     uint8_t num_sensors;
 
+    /* this wake only, merged into the RTC statistics once all are done */
+    uint16_t latency[SENSOR_MAX_SENSORS];
+    uint8_t polls[SENSOR_MAX_SENSORS];
+    bool finished[SENSOR_MAX_SENSORS];
+    struct sensor_stats_rtc *stats = nullptr;
+    SampleBuffer buffer;
+
     void new_sensor(JsonVariant &);
+    void save_stats();
+    void detect_changes();
+    void mark_published();
+    void buffer_samples();
+    void publish_buffer(LineProtocol &);
 
 public:
-    void register_sensor_class(const char *, SensorFactory *);
-
     bool upload_requested();
     bool sensors_done();
+    bool skip_sampling();
 
-    void publish(InfluxDBClient *, String *, char *, const char *);
+    /* the points as line protocol */
+    void publish(LineProtocol &);
+    void publish_stats(LineProtocol &);
     uint8_t get_num_sensors();
+    uint16_t get_num_points();
+    BusManager *get_bus_manager() { return &buses; }
     void loop();
+    uint32_t idle_time();
+    void sleep(uint32_t sleep_s) { buffer.sleep(sleep_s); }
 
-    explicit SensorManager(const JsonArray &);
+    /* buffer_words of RTC memory keep samples for batched uploads */
+    SensorManager(const JsonArray &, uint16_t buffer_words = 0);
     ~SensorManager() {}
 };
 
 
+/*
+ * Sensors are sampled in three steps: start() kicks off a measurement and
+ * must not block, ready_at() tells the millis() value at which sample() is
+ * worth calling again and sample() collects the result. sample() returns
+ * SENSOR_INIT as long as the measurement is still in progress.
+ */
 class Sensor {
+protected:
+    struct sensor_counters counters = {};
+    /* drivers add their fields in order of get_values() */
+    ChangeDetector change;
+
 public:
+    virtual void start() {}
+    virtual uint32_t ready_at() { return millis(); }
     virtual Sensor_State sample() = 0;
-    virtual void publish(Point &) = 0;
+
+    /* sensors with several probes publish one point per probe */
+    virtual uint8_t get_num_points() { return 1; }
+
+    /*
+     * get_values() hands out the raw values of a point measured during this
+     * wake, 0 if there are none. publish_values() adds values handed out
+     * earlier to a point. Whether they are worth an upload is decided by
+     * the SensorManager.
+     */
+    virtual uint8_t get_values(uint8_t, float *) { return 0; }
+    virtual void publish_values(LineProtocol &, uint8_t, const float *,
+                                uint8_t) {}
 
     virtual const char *get_sensor_type() = 0;
     virtual String &get_tags() = 0;
 
-    Sensor() {}
-    virtual ~Sensor() {};
-};
+    /* sensors on the same bus are sampled back to back */
+    virtual Bus *get_bus() { return nullptr; }
 
+    const struct sensor_counters &get_counters() { return counters; }
+    ChangeDetector &get_change() { return change; }
 
-class SensorFactory {
-protected:
-    SensorManager *manager = nullptr;
-
-public:
-    virtual Sensor *new_instance(JsonVariant &) = 0;
-    virtual void register_factory(SensorManager *) = 0;
-    SensorFactory() {};
-    ~SensorFactory() {};
+    Sensor() {}
+    virtual ~Sensor() {};
 };
-
-bool threshold_helper_float(float, float, float);
 #endif
@@ -0,0 +1,26 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _SENSOR_DRIVERS_H_
+#define _SENSOR_DRIVERS_H_
+
+/*
+ * Sensor drivers built into the image, selected with build flags like
+ * -DSENSOR_BME280 -DSENSOR_DS18B20. Without any of them all drivers are
+ * built. Drivers which are not selected are not referenced and dropped by
+ * the linker.
+ */
+#if !defined(SENSOR_ADC) && !defined(SENSOR_BME280) && \
+    !defined(SENSOR_DS18B20) && !defined(SENSOR_SML) && \
+    !defined(SENSOR_VINDRIKTNING)
+#define SENSOR_ADC
+#define SENSOR_BME280
+#define SENSOR_DS18B20
+#define SENSOR_SML
+#define SENSOR_VINDRIKTNING
+#endif
+
+#endif
@@ -7,13 +7,9 @@
 #ifndef _ADC_H_
 #define _ADC_H_
 
-#include "rtcmem_map.h"
 #include "sensor.h"
 
-struct adc_rtc_data {
-    uint32_t data_upload;
-    float current_value;
-}__attribute__ ((aligned(4)));
+#define ADC_RTCMEM_WORDS    CHANGE_RTCMEM_WORDS(1, 1)
 
 class Sensor_ADC : public Sensor {
 private:
@@ -22,41 +18,27 @@ private:
    float r2;
    float offset;
    float factor;
-   float threshold_voltage;
-   int mem;
-   bool data_upload;
-   adc_rtc_data rtc_data;
+   bool measured = false;
    static constexpr const char *sensor_type = "ADC";
    String tags;
    Sensor_State state = SENSOR_INIT;
 
 public:
     Sensor_State sample() override;
-    void publish(Point &) override;
+    uint8_t get_values(uint8_t, float *) override;
+    void publish_values(LineProtocol &, uint8_t, const float *,
+                        uint8_t) override;
 
     const char *get_sensor_type() override;
     String &get_tags() override;
 
     explicit Sensor_ADC(const JsonVariant &);
 
-    Sensor_ADC() : current_value(0), r1(9100.), r2(47000.), offset(0.), factor(1.), mem(-1), data_upload(false), tags() {}
+    Sensor_ADC() : current_value(0), r1(9100.), r2(47000.), offset(0.), factor(1.), tags() {}
     ~Sensor_ADC() {}
-};
-
-class ADCFactory : public SensorFactory {
-    static constexpr const char *type_str = "ADC";
-
-public:
-    Sensor *new_instance(JsonVariant &cfg) override {
-        return new Sensor_ADC(cfg);
-    }
 
-    void register_factory(SensorManager *sm) override {
-        this->manager = sm;
-        this->manager->register_sensor_class(type_str, this);
+    static Sensor *create(JsonVariant &cfg, SensorManager *, void *mem) {
+        return new (mem) Sensor_ADC(cfg);
     }
-
-    ADCFactory() {}
-    ~ADCFactory() {}
 };
 #endif
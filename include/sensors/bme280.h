@@ -8,65 +8,63 @@
 #ifndef _BME280_H_
 #define _BME280_H_
 
-#include <Adafruit_BME280.h>
+#include <bme280_driver.h>
 #include <Wire.h>
 
-#include "rtcmem_map.h"
+#include "bus.h"
+#include "rtcmem.h"
 #include "sensor.h"
 
-struct bme280_rtc_data {
-    uint32_t data_upload;
-    float temp;
-    float hum;
-    float pres;
+#define BME280_ADDR_PRIMARY     0x76
+#define BME280_ADDR_SECONDARY   0x77
+
+/* calibration does not change, read it once after power on */
+struct bme280_calib_cache {
+    uint8_t addr;           /* 0 until the chip has been found */
+    uint8_t raw[BME280_CALIB_SIZE];
 }__attribute__ ((aligned(4)));
 
+#define BME280_RTCMEM_WORDS \
+    (RTCMEM_RECORD_WORDS(sizeof(struct bme280_calib_cache)) + \
+     CHANGE_RTCMEM_WORDS(3, 1))
+
 class Sensor_BME280 : public Sensor {
 private:
-    static constexpr const int addr = 0x76;
+    uint8_t addr;
     int sda, scl;
     float temp, hum, pres;
     bool initialized;
-    TwoWire i2c;
-    Adafruit_BME280 bme;
-    float threshold_pres;
-    float threshold_hum;
-    float threshold_temp;
-    int mem;
-    bme280_rtc_data rtc_data;
+    I2CBus *bus;
+    BME280Driver bme;
+    bme280_calib_cache *calib;
     static constexpr const char *sensor_type = "BME280";
     String tags;
-    bool data_upload;
+    bool measured = false;
     Sensor_State state = SENSOR_NOT_INIT;
+    uint32_t conversion_done = 0;
+
+    bool load_calibration();
 
 public:
+    void start() override;
+    uint32_t ready_at() override;
     Sensor_State sample() override;
-    void publish(Point &) override;
+    uint8_t get_values(uint8_t, float *) override;
+    void publish_values(LineProtocol &, uint8_t, const float *,
+                        uint8_t) override;
 
     const char *get_sensor_type() override;
     String &get_tags() override;
+    Bus *get_bus() override { return bus; }
 
-    explicit Sensor_BME280(const JsonVariant &);
-    Sensor_BME280() : sda(2), scl(14), temp(21.), hum(50.), pres(1080.),
-    initialized(false), bme(), mem(-1), tags(), data_upload(false) {}
+    Sensor_BME280(const JsonVariant &, BusManager *);
+    Sensor_BME280() : addr(BME280_ADDR_PRIMARY), sda(2), scl(14), temp(21.),
+    hum(50.), pres(1080.), initialized(false), bus(nullptr), bme(&Wire, addr),
+    calib(nullptr), tags() {}
     ~Sensor_BME280() {}
-};
-
 
-class BME280Factory : public SensorFactory {
-    static constexpr const char *type_str = "BME280";
-
-public:
-    Sensor *new_instance(JsonVariant &cfg) override {
-        return new Sensor_BME280(cfg);
+    static Sensor *create(JsonVariant &cfg, SensorManager *sm, void *mem) {
+        return new (mem) Sensor_BME280(cfg, sm->get_bus_manager());
     }
-
-    void register_factory(SensorManager *sm) override {
-        this->manager = sm;
-        this->manager->register_sensor_class(type_str, this);
-    }
-
-    BME280Factory() {}
-    ~BME280Factory() {}
 };
 #endif
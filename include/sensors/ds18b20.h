@@ -11,53 +11,75 @@
 
 #include <DS18B20.h>
 
-#include "rtcmem_map.h"
+#include "bus.h"
+#include "rtcmem.h"
 #include "sensor.h"
 
-struct ds18b20_rtc_data {
-    float temp;
+/* every probe is a point of its own and takes a word of RTC memory */
+#define DS18B20_MAX_PROBES 16
+/* externally powered probes signal the end of the conversion on the bus */
+#define DS18B20_POLL_MS    10
+
+/* larger buses are searched on every wake, the ROM IDs take 2 words each */
+#define DS18B20_CACHE_PROBES 12
+
+/*
+ * Result of the last bus search, kept across deep sleep. The record is sized
+ * to the probes found, 1 + 2 * num_probes words.
+ */
+struct ds18b20_rom_cache {
+    uint8_t num_probes;     /* 0 if the cache is not valid */
+    uint8_t resolution;
+    uint8_t power_mode;
+    uint8_t wakes_left;     /* until the next full search */
+    uint8_t rom[][8];
 }__attribute__ ((aligned(4)));
 
 class Sensor_DS18B20 : public Sensor {
 private:
-    float temp;
+    float temp[DS18B20_MAX_PROBES];
+    uint8_t rom[DS18B20_MAX_PROBES][8];
+    uint8_t num_probes;
     bool initialized;
+    OneWireBus *bus;
     DS18B20 *ds;
-    float threshold_temp;
-    int mem;
-    ds18b20_rtc_data rtc_data;
+    ds18b20_rom_cache *rom_cache;
+    size_t rom_cache_size;
+    uint8_t rom_cache_instance;
+    uint8_t rescan_after;
+    uint8_t resolution;
+    uint32_t next_poll = 0;
     static constexpr const char *sensor_type = "DS18B20";
     String tags;
     Sensor_State state = SENSOR_NOT_INIT;
 
+    bool load_rom_cache(BusManager *, uint8_t);
+    void save_rom_cache(uint8_t);
+    void invalidate_rom_cache();
+    void scan(BusManager *, uint8_t);
+
 public:
+    void start() override;
+    uint32_t ready_at() override;
     Sensor_State sample() override;
-    void publish(Point &) override;
+    uint8_t get_num_points() override;
+    uint8_t get_values(uint8_t, float *) override;
+    void publish_values(LineProtocol &, uint8_t, const float *,
+                        uint8_t) override;
 
     const char *get_sensor_type() override;
     String &get_tags() override;
+    Bus *get_bus() override { return bus; }
 
-    explicit Sensor_DS18B20(const JsonVariant &);
-    Sensor_DS18B20() : temp(21.), initialized(false), ds(nullptr), mem(-1),
+    Sensor_DS18B20(const JsonVariant &, BusManager *);
+    Sensor_DS18B20() : num_probes(0), initialized(false), bus(nullptr),
+    ds(nullptr), rom_cache(nullptr), rom_cache_size(0),
+    rom_cache_instance(0), rescan_after(0), resolution(0),
     tags() {}
     ~Sensor_DS18B20() {}
-};
 
-
-class DS18B20Factory : public SensorFactory {
-    static constexpr const char *type_str = "DS18B20";
-
-public:
-    Sensor *new_instance(JsonVariant &cfg) override {
-        return new Sensor_DS18B20(cfg);
+    static Sensor *create(JsonVariant &cfg, SensorManager *sm, void *mem) {
+        return new (mem) Sensor_DS18B20(cfg, sm->get_bus_manager());
     }
-
-    void register_factory(SensorManager *sm) override {
-        this->manager = sm;
-        this->manager->register_sensor_class(type_str, this);
-    }
-
-    DS18B20Factory() {}
-    ~DS18B20Factory() {}
 };
 #endif
@@ -8,74 +8,73 @@
 #ifndef _SML_H_
 #define _SML_H_
 
-#include <SoftwareSerial.h>
+#include <sml_stream.h>
 
-#include "rtcmem_map.h"
 #include "sensor.h"
+#include "uart.h"
 
-struct sml_rtc_data {
-	uint32_t data_upload;
-	float energy_total_positive;
-	float energy_total_negative;
-	float power_current;
-}__attribute__ ((aligned(4)));
+/* every value takes one word of RTC memory for the change detection */
+#define SML_MAX_OBIS 7
+/* poll interval once all values are in, the CRC follows within ~40 bytes */
+#define SML_TRAILER_POLL_MS 10
+
+/*
+ * OBIS codes are packed big endian into the lower 48 bits of key, so a value
+ * list entry is matched with a single compare. If the code in the config has
+ * no F group, mask leaves it out.
+ */
+struct sml_obis {
+	uint64_t key;
+	uint64_t mask;
+	String field;
+	float factor;
+	float value;
+};
 
 class Sensor_SML : public Sensor {
 private:
 	int rx, tx;
-	float energy_total_positive;
-	float energy_total_negative;
-	float power_current;
+	sml_obis obis[SML_MAX_OBIS];
+	uint8_t num_obis;
 	bool initialized;
-	std::shared_ptr<SoftwareSerial> sensor_serial;
+	UartPort *port;
 	float threshold_energy;
 	float threshold_power;
-	int mem;
-	sml_rtc_data rtc_data;
 	static constexpr const char *sensor_type = "SML";
 	String tags;
 	Sensor_State state = SENSOR_NOT_INIT;
-	std::vector<uint8_t> sml_message;
-	bool data_upload;
-	uint16_t incoming_mask = 0;
-	bool record = false;
-	bool finished = false;
+	uint32_t next_poll = 0;
+	bool measured = false;
+	/* poll every SML_TRAILER_POLL_MS once all values are in, they are
+	 * still only taken after the CRC at the end of the telegram
+	 */
+	bool fast_poll;
+	esphome::sml::SmlStreamDecoder decoder;
+	uint8_t obis_seen = 0;
+	float pending[SML_MAX_OBIS];
 
-	void rx_buf_clear();
-	bool sample_process();
-	bool checksum_check();
-	char check_start_end_bytes(uint8_t);
+	bool add_obis(const JsonVariant &, const char *, const char *, float,
+		      float);
+	void process_entry(const esphome::sml::SmlObisEntry &);
+	bool receive();
 
 public:
+	uint32_t ready_at() override;
 	Sensor_State sample() override;
-	void publish(Point &) override;
+	uint8_t get_values(uint8_t, float *) override;
+	void publish_values(LineProtocol &, uint8_t, const float *,
+			    uint8_t) override;
 
 	const char *get_sensor_type() override;
 	String &get_tags() override;
 
 	explicit Sensor_SML(const JsonVariant &);
-	Sensor_SML() : rx(4), tx(5), energy_total_positive(0.0),
-	energy_total_negative(0.0), power_current(0.0),
-	initialized(false), sensor_serial(), mem(-1), tags(),
-	data_upload(false) {}
+	Sensor_SML() : rx(4), tx(5), num_obis(0),
+	initialized(false), port(nullptr), tags(), fast_poll(false) {}
 	~Sensor_SML() {}
-};
-
 
-class SMLFactory : public SensorFactory {
-	static constexpr const char *type_str = "SML";
-
-public:
-	Sensor *new_instance(JsonVariant &cfg) override {
-		return new Sensor_SML(cfg);
+	static Sensor *create(JsonVariant &cfg, SensorManager *, void *mem) {
+		return new (mem) Sensor_SML(cfg);
 	}
-
-	void register_factory(SensorManager *sm) override {
-		this->manager = sm;
-		this->manager->register_sensor_class(type_str, this);
-	}
-
-	SMLFactory() {}
-	~SMLFactory() {}
 };
 #endif
@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _TLS_SESSION_H_
+#define _TLS_SESSION_H_
+
+#include <Arduino.h>
+#include <WiFiClientSecureBearSSL.h>
+
+/* servers forget sessions after a while, a stale one costs a round trip */
+#define TLS_SESSION_MAX_AGE_S   (24 * 3600)
+
+/* 24 words of RTC memory */
+struct tls_session_entry {
+    uint32_t host;          /* crc32 of the host name */
+    uint32_t expires : 31;  /* time(), 0 if the entry is not used */
+    uint32_t mfln : 1;      /* max fragment length of 1024 supported */
+    br_ssl_session_parameters params;
+} __attribute__((aligned(4)));
+
+/*
+ * The BearSSL session parameters of the InfluxDB host, kept in RTC memory so
+ * that the next wake resumes the session with an abbreviated handshake
+ * instead of a full key exchange. The control server is only contacted for
+ * the occasional OTA check and does not get a slot. offer() hands the cached
+ * session to a WiFiClientSecure through the Session object, which BearSSL
+ * updates after the handshake. update() must only be called once a
+ * connection was established, it stores the session and counts whether the
+ * server resumed it.
+ */
+class TlsSessionCache {
+private:
+    struct tls_session_entry *entry = nullptr;
+    uint8_t offered_id[32];
+    uint8_t offered_len = 0;
+    uint8_t hits = 0;
+    uint8_t misses = 0;
+
+    struct tls_session_entry *find(uint32_t host);
+
+public:
+    void begin();
+
+    /* true if a session was cached, mfln as probed with it */
+    bool offer(const char *host, BearSSL::Session &, bool &mfln);
+    void update(const char *host, BearSSL::Session &, bool mfln);
+
+    uint8_t get_hits() { return hits; }
+    uint8_t get_misses() { return misses; }
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _UART_H_
+#define _UART_H_
+
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+
+#define UART_MAX_PORTS          3
+#define UART_RX_BUFFER_SIZE     256
+/* 256 bytes last about 260 ms at 9600 baud, drain well before that */
+#define UART_POLL_MS            100
+
+/* UART0 RX/TX after Serial.swap() */
+#define UART_HW_RX_PIN          13
+#define UART_HW_TX_PIN          15
+
+/*
+ * Receive side of a serial sensor. Bytes are captured in interrupt context
+ * either by the UART0 driver or by SoftwareSerial and are pulled out of their
+ * receive buffers in bulk, so the sensors do not have to poll byte by byte.
+ */
+class UartPort {
+private:
+    Stream *stream = nullptr;
+    bool hw = false;
+    int8_t rx = -1;
+    int8_t tx = -1;
+    uint32_t baud = 0;
+    uint32_t overruns = 0;
+    uint32_t bytes_read = 0;
+
+    void check_overrun();
+
+    friend UartPort *uart_open(int8_t, int8_t, uint32_t, bool);
+
+public:
+    size_t read(uint8_t *, size_t);
+
+    bool is_hw() { return hw; }
+    uint32_t get_overruns() { return overruns; }
+    uint32_t get_bytes_read() { return bytes_read; }
+};
+
+/*
+ * Sets up a port listening on rx, nullptr if rx is taken already. With hw set
+ * and rx/tx on GPIO13/GPIO15 UART0 is swapped over to the sensor in receive
+ * only mode, console output is dropped until uart_release().
+ */
+UartPort *uart_open(int8_t rx, int8_t tx, uint32_t baud, bool hw = false);
+/* UART0 back to the console, hardware ports read nothing afterwards */
+void uart_release();
+
+#endif
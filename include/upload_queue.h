@@ -0,0 +1,54 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _UPLOAD_QUEUE_H_
+#define _UPLOAD_QUEUE_H_
+
+#include <Arduino.h>
+
+#define UPLOAD_QUEUE_DIR            "/queue"
+/* bytes per segment file, also the most that is read into RAM at once */
+#define UPLOAD_QUEUE_SEGMENT_SIZE   4096
+/* 64 KB at most, the oldest segment is dropped beyond that */
+#define UPLOAD_QUEUE_MAX_SEGMENTS   16
+/* requests are kept small, the server sees at most this many bytes each */
+#define UPLOAD_CHUNK_SIZE           1024
+/* compressed requests take more lines, they shrink to a fraction */
+#define UPLOAD_GZIP_CHUNK_SIZE      4096
+/* segments sent after the data of the current wake, keeps uploads short */
+#define UPLOAD_QUEUE_DRAIN_SEGMENTS 4
+/* an unreachable server must not keep the radio on for long */
+#define UPLOAD_TIMEOUT_MS           3000
+
+/*
+ * Line protocol which could not be uploaded is appended to a log on
+ * LittleFS and sent once the server can be reached again. The log is split
+ * into segment files which are only ever appended to and removed once sent,
+ * so flash is not rewritten in place. Every line carries its time stamp, a
+ * segment that was partly sent before is simply sent again.
+ */
+class UploadQueue {
+private:
+    uint32_t first = 0;     /* oldest segment */
+    uint32_t next = 0;      /* segment after the newest one */
+    bool scanned = false;
+
+    void scan();
+    String segment_name(uint32_t);
+
+public:
+    void add(const char *lines, size_t len);
+    bool empty();
+
+    /* oldest segment, false if there is none */
+    bool oldest(String &lines);
+    void drop_oldest();
+};
+
+/* length of the longest run of whole lines in s not above max bytes */
+size_t upload_chunk_len(const char *s, size_t len, size_t max);
+
+#endif
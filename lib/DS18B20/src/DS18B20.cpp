@@ -1,13 +1,22 @@
 #include <DS18B20.h>
 
-DS18B20::DS18B20(uint8_t pin) :
+// With search set to false the bus is not enumerated, the caller has to
+// provide what a search would have found through restoreBus().
+DS18B20::DS18B20(uint8_t pin, bool search) :
     oneWire(OneWire(pin)),
     numberOfDevices(0),
     globalResolution(0),
     selectedResolution(0),
-    selectedPowerMode(0)
+    selectedPowerMode(0),
+    conversionStart(0)
 {
     resetSearch();
+
+    if (!search) {
+        globalPowerMode = 0;
+        return;
+    }
+
     sendCommand(SKIP_ROM, READ_POWER_SUPPLY);
     globalPowerMode = oneWire.read_bit();
 
@@ -64,6 +73,34 @@ float DS18B20::getTempC() {
     sendCommand(MATCH_ROM, CONVERT_T, !selectedPowerMode);
     delayForConversion(selectedResolution, selectedPowerMode);
     readScratchpad();
+
+    return scratchpadToTempC();
+}
+
+// Reads the result of a previous conversion (e.g. doConversion()) from the
+// device with the given address, without a search and without converting.
+uint8_t DS18B20::readTempC(uint8_t address[], float *temp) {
+    memcpy(selectedAddress, address, 8);
+
+    if (!sendCommand(MATCH_ROM, READ_SCRATCHPAD)) {
+        return 0;
+    }
+
+    for (uint8_t i = 0; i < SIZE_SCRATCHPAD; i++) {
+        selectedScratchpad[i] = oneWire.read();
+    }
+
+    if (OneWire::crc8(selectedScratchpad, 8) != selectedScratchpad[CRC8]) {
+        return 0;
+    }
+
+    selectedResolution = getResolution();
+    *temp = scratchpadToTempC();
+
+    return 1;
+}
+
+float DS18B20::scratchpadToTempC() {
     uint8_t lsb = selectedScratchpad[TEMP_LSB];
     uint8_t msb = selectedScratchpad[TEMP_MSB];
 
@@ -149,10 +186,45 @@ void DS18B20::doConversion() {
     delayForConversion(globalResolution, globalPowerMode);
 }
 
+// Non-blocking variant of doConversion(), the results can be read with
+// readTempC() once isReady() returns true.
+void DS18B20::startConversion() {
+    sendCommand(SKIP_ROM, CONVERT_T, !globalPowerMode);
+    conversionStart = millis();
+}
+
+uint32_t DS18B20::conversionReadyAt() {
+    return conversionStart + conversionTime(globalResolution);
+}
+
+// Externally powered devices pull the bus low while converting, parasite
+// powered ones need the strong pull-up for the full conversion time.
+uint8_t DS18B20::isReady() {
+    if (globalPowerMode) {
+        return oneWire.read_bit();
+    }
+
+    return (int32_t)(millis() - conversionReadyAt()) >= 0;
+}
+
 uint8_t DS18B20::getNumberOfDevices() {
     return numberOfDevices;
 }
 
+uint8_t DS18B20::getGlobalResolution() {
+    return globalResolution;
+}
+
+uint8_t DS18B20::getGlobalPowerMode() {
+    return globalPowerMode;
+}
+
+void DS18B20::restoreBus(uint8_t resolution, uint8_t powerMode, uint8_t devices) {
+    globalResolution = resolution;
+    globalPowerMode = powerMode;
+    numberOfDevices = devices;
+}
+
 uint8_t DS18B20::hasAlarm() {
     uint8_t oldResolution = selectedResolution;
     setResolution(9);
@@ -350,19 +422,19 @@ void DS18B20::delayForConversion(uint8_t resolution, uint8_t powerMode) {
     if (powerMode) {
         while (!oneWire.read_bit());
     } else {
-        switch (resolution) {
-            case 9:
-                delay(CONV_TIME_9_BIT);
-                break;
-            case 10:
-                delay(CONV_TIME_10_BIT);
-                break;
-            case 11:
-                delay(CONV_TIME_11_BIT);
-                break;
-            case 12:
-                delay(CONV_TIME_12_BIT);
-                break;
-        }
+        delay(conversionTime(resolution));
+    }
+}
+
+uint16_t DS18B20::conversionTime(uint8_t resolution) {
+    switch (resolution) {
+        case 9:
+            return CONV_TIME_9_BIT;
+        case 10:
+            return CONV_TIME_10_BIT;
+        case 11:
+            return CONV_TIME_11_BIT;
+        default:
+            return CONV_TIME_12_BIT;
     }
 }
@@ -37,12 +37,13 @@
 
 class DS18B20 {
     public:
-        DS18B20(uint8_t pin);
+        DS18B20(uint8_t pin, bool search = true);
         uint8_t select(uint8_t address[]);
         uint8_t selectNext();
         uint8_t selectNextAlarm();
         void resetSearch();
         float getTempC();
+        uint8_t readTempC(uint8_t address[], float *temp);
         float getTempF();
         uint8_t getResolution();
         void setResolution(uint8_t resolution);
@@ -50,7 +51,13 @@ class DS18B20 {
         uint8_t getFamilyCode();
         void getAddress(uint8_t address[]);
         void doConversion();
+        void startConversion();
+        uint32_t conversionReadyAt();
+        uint8_t isReady();
         uint8_t getNumberOfDevices();
+        uint8_t getGlobalResolution();
+        uint8_t getGlobalPowerMode();
+        void restoreBus(uint8_t resolution, uint8_t powerMode, uint8_t devices);
         uint8_t hasAlarm();
         void setAlarms(int8_t alarmLow, int8_t alarmHigh);
         int8_t getAlarmLow();
@@ -74,13 +81,16 @@ class DS18B20 {
         uint8_t searchAddress[8];
         uint8_t lastDiscrepancy;
         uint8_t lastDevice;
+        uint32_t conversionStart;
         uint8_t readScratchpad();
+        float scratchpadToTempC();
         void writeScratchpad();
         uint8_t sendCommand(uint8_t romCommand);
         uint8_t sendCommand(uint8_t romCommand, uint8_t functionCommand, uint8_t power = 0);
         uint8_t oneWireSearch(uint8_t romCommand);
         uint8_t isConnected(uint8_t address[]);
         void delayForConversion(uint8_t resolution, uint8_t powerMode);
+        uint16_t conversionTime(uint8_t resolution);
 };
 
 #endif
@@ -0,0 +1,197 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <string.h>
+
+#include "bme280_driver.h"
+
+#define BME280_REG_CALIB0       0x88
+#define BME280_REG_CHIP_ID      0xd0
+#define BME280_REG_CALIB1       0xe1
+#define BME280_REG_CTRL_HUM     0xf2
+#define BME280_REG_CTRL_MEAS    0xf4
+#define BME280_REG_DATA         0xf7
+
+#define BME280_CHIP_ID          0x60
+#define BME280_CALIB0_SIZE      26
+#define BME280_DATA_SIZE        8
+#define BME280_MODE_FORCED      0x01
+
+bool BME280Driver::read_regs(uint8_t reg, uint8_t *buf, uint8_t len) {
+    wire->beginTransmission(addr);
+    wire->write(reg);
+    if (wire->endTransmission(false))
+        return false;
+
+    if (wire->requestFrom(addr, len) != len)
+        return false;
+
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = wire->read();
+
+    return true;
+}
+
+bool BME280Driver::write_reg(uint8_t reg, uint8_t val) {
+    wire->beginTransmission(addr);
+    wire->write(reg);
+    wire->write(val);
+    return !wire->endTransmission();
+}
+
+static uint16_t le16(const uint8_t *b) {
+    return b[0] | (b[1] << 8);
+}
+
+void BME280Driver::parse_calibration() {
+    const uint8_t *b = raw_calib;
+    const uint8_t *h = raw_calib + BME280_CALIB0_SIZE;
+
+    calib.t1 = le16(b + 0);
+    calib.t2 = le16(b + 2);
+    calib.t3 = le16(b + 4);
+    calib.p1 = le16(b + 6);
+    calib.p2 = le16(b + 8);
+    calib.p3 = le16(b + 10);
+    calib.p4 = le16(b + 12);
+    calib.p5 = le16(b + 14);
+    calib.p6 = le16(b + 16);
+    calib.p7 = le16(b + 18);
+    calib.p8 = le16(b + 20);
+    calib.p9 = le16(b + 22);
+    calib.h1 = b[25];
+
+    calib.h2 = le16(h + 0);
+    calib.h3 = h[2];
+    /* 12 bit signed values sharing 0xe5 */
+    calib.h4 = ((int8_t)h[3] * 16) | (h[4] & 0x0f);
+    calib.h5 = ((int8_t)h[5] * 16) | (h[4] >> 4);
+    calib.h6 = h[6];
+}
+
+bool BME280Driver::begin(const uint8_t *calibration) {
+    uint8_t id;
+
+    if (calibration) {
+        memcpy(raw_calib, calibration, sizeof(raw_calib));
+        parse_calibration();
+        return true;
+    }
+
+    if (!read_regs(BME280_REG_CHIP_ID, &id, 1) || id != BME280_CHIP_ID)
+        return false;
+
+    if (!read_regs(BME280_REG_CALIB0, raw_calib, BME280_CALIB0_SIZE) ||
+        !read_regs(BME280_REG_CALIB1, raw_calib + BME280_CALIB0_SIZE,
+                   BME280_CALIB_SIZE - BME280_CALIB0_SIZE))
+        return false;
+
+    parse_calibration();
+    return true;
+}
+
+static uint8_t osrs_clamp(uint8_t osrs) {
+    return osrs > (uint8_t)BME280_OSRS_X16 ? (uint8_t)BME280_OSRS_X16 : osrs;
+}
+
+void BME280Driver::set_oversampling(uint8_t t, uint8_t p, uint8_t h) {
+    osrs_t = osrs_clamp(t);
+    osrs_p = osrs_clamp(p);
+    osrs_h = osrs_clamp(h);
+}
+
+uint32_t BME280Driver::measurement_time_us() {
+    uint32_t t = 1250;
+
+    if (osrs_t)
+        t += 2300 * (1 << (osrs_t - 1));
+    if (osrs_p)
+        t += 2300 * (1 << (osrs_p - 1)) + 575;
+    if (osrs_h)
+        t += 2300 * (1 << (osrs_h - 1)) + 575;
+
+    return t;
+}
+
+/* ctrl_hum only takes effect with the following write to ctrl_meas */
+bool BME280Driver::start() {
+    return write_reg(BME280_REG_CTRL_HUM, osrs_h) &&
+           write_reg(BME280_REG_CTRL_MEAS,
+                     (osrs_t << 5) | (osrs_p << 2) | BME280_MODE_FORCED);
+}
+
+bool BME280Driver::read(bme280_data *d) {
+    uint8_t b[BME280_DATA_SIZE];
+    int32_t adc_p, adc_t, adc_h, t_fine;
+
+    if (!read_regs(BME280_REG_DATA, b, sizeof(b)))
+        return false;
+
+    adc_p = ((uint32_t)b[0] << 12) | (b[1] << 4) | (b[2] >> 4);
+    adc_t = ((uint32_t)b[3] << 12) | (b[4] << 4) | (b[5] >> 4);
+    adc_h = (b[6] << 8) | b[7];
+
+    /* skipped measurements read back as 0x80000 / 0x8000 */
+    if (adc_t == 0x80000)
+        return false;
+
+    d->temp = compensate_temp(adc_t, &t_fine);
+    d->pres = osrs_p ? compensate_pres(adc_p, t_fine) : 0;
+    d->hum = osrs_h ? compensate_hum(adc_h, t_fine) : 0;
+
+    return true;
+}
+
+/* the compensation formulas are taken from the datasheet, section 4.2.3 */
+int32_t BME280Driver::compensate_temp(int32_t adc_t, int32_t *t_fine) {
+    int32_t var1, var2;
+
+    var1 = ((((adc_t >> 3) - ((int32_t)calib.t1 << 1))) *
+            ((int32_t)calib.t2)) >> 11;
+    var2 = (((((adc_t >> 4) - ((int32_t)calib.t1)) *
+              ((adc_t >> 4) - ((int32_t)calib.t1))) >> 12) *
+            ((int32_t)calib.t3)) >> 14;
+    *t_fine = var1 + var2;
+
+    return (*t_fine * 5 + 128) >> 8;
+}
+
+uint32_t BME280Driver::compensate_pres(int32_t adc_p, int32_t t_fine) {
+    int64_t var1, var2, p;
+
+    var1 = ((int64_t)t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)calib.p6;
+    var2 = var2 + ((var1 * (int64_t)calib.p5) << 17);
+    var2 = var2 + (((int64_t)calib.p4) << 35);
+    var1 = ((var1 * var1 * (int64_t)calib.p3) >> 8) +
+           ((var1 * (int64_t)calib.p2) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)calib.p1) >> 33;
+    if (var1 == 0)
+        return 0;
+
+    p = 1048576 - adc_p;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)calib.p9) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)calib.p8) * p) >> 19;
+
+    return ((p + var1 + var2) >> 8) + (((int64_t)calib.p7) << 4);
+}
+
+uint32_t BME280Driver::compensate_hum(int32_t adc_h, int32_t t_fine) {
+    int32_t v;
+
+    v = t_fine - ((int32_t)76800);
+    v = (((((adc_h << 14) - (((int32_t)calib.h4) << 20) -
+            (((int32_t)calib.h5) * v)) + ((int32_t)16384)) >> 15) *
+         (((((((v * ((int32_t)calib.h6)) >> 10) *
+              (((v * ((int32_t)calib.h3)) >> 11) + ((int32_t)32768))) >> 10) +
+            ((int32_t)2097152)) * ((int32_t)calib.h2) + 8192) >> 14));
+    v = v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t)calib.h1)) >> 4);
+    v = v < 0 ? 0 : v;
+    v = v > 419430400 ? 419430400 : v;
+
+    return (uint32_t)(v >> 12);
+}
@@ -0,0 +1,87 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _BME280_DRIVER_H_
+#define _BME280_DRIVER_H_
+
+#include <stdint.h>
+#include <Wire.h>
+
+/* calibration registers 0x88-0xa1 followed by 0xe1-0xe7 */
+#define BME280_CALIB_SIZE   33
+
+/* oversampling settings as written to the osrs_x fields */
+enum BME280_Oversampling : uint8_t {
+    BME280_OSRS_SKIP = 0,
+    BME280_OSRS_X1,
+    BME280_OSRS_X2,
+    BME280_OSRS_X4,
+    BME280_OSRS_X8,
+    BME280_OSRS_X16,
+};
+
+struct bme280_calib {
+    uint16_t t1;
+    int16_t t2, t3;
+    uint16_t p1;
+    int16_t p2, p3, p4, p5, p6, p7, p8, p9;
+    uint8_t h1;
+    int16_t h2;
+    uint8_t h3;
+    int16_t h4, h5;
+    int8_t h6;
+};
+
+/* results in fixed point as returned by the Bosch integer compensation */
+struct bme280_data {
+    int32_t temp;       /* 0.01 °C */
+    uint32_t pres;      /* Pa, Q24.8 */
+    uint32_t hum;       /* %RH, Q22.10 */
+};
+
+/*
+ * Forced mode only: start() triggers a single measurement, the chip goes
+ * back to sleep by itself once it is done. All data registers are fetched
+ * in a single burst and compensated with integer arithmetic.
+ */
+class BME280Driver {
+private:
+    TwoWire *wire;
+    uint8_t addr;
+    uint8_t raw_calib[BME280_CALIB_SIZE];
+    bme280_calib calib;
+    uint8_t osrs_t = BME280_OSRS_X1;
+    uint8_t osrs_p = BME280_OSRS_X1;
+    uint8_t osrs_h = BME280_OSRS_X1;
+
+    bool read_regs(uint8_t, uint8_t *, uint8_t);
+    bool write_reg(uint8_t, uint8_t);
+    void parse_calibration();
+
+    int32_t compensate_temp(int32_t, int32_t *);
+    uint32_t compensate_pres(int32_t, int32_t);
+    uint32_t compensate_hum(int32_t, int32_t);
+
+public:
+    /*
+     * Checks the chip ID and reads the calibration. If calibration data is
+     * passed (e.g. kept in RTC memory) the chip is not accessed at all.
+     */
+    bool begin(const uint8_t *calibration = nullptr);
+    const uint8_t *get_calibration() { return raw_calib; }
+    void set_address(uint8_t a) { addr = a; }
+
+    void set_oversampling(uint8_t t, uint8_t p, uint8_t h);
+    /* worst case measurement time from the datasheet, appendix B */
+    uint32_t measurement_time_us();
+
+    bool start();
+    bool read(bme280_data *);
+
+    BME280Driver(TwoWire *w, uint8_t a) : wire(w), addr(a) {}
+};
+
+#endif
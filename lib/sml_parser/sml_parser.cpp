@@ -83,19 +83,23 @@ std::string bytes_repr(const bytes &buffer) {
   return repr;
 }
 
-uint64_t bytes_to_uint(const bytes &buffer) {
+uint64_t bytes_to_uint(const bytes &buffer) { return bytes_to_uint(buffer.data(), buffer.size()); }
+
+uint64_t bytes_to_uint(const uint8_t *buffer, size_t length) {
   uint64_t val = 0;
-  for (auto const value : buffer) {
-    val = (val << 8) + value;
+  for (size_t i = 0; i < length; i++) {
+    val = (val << 8) + buffer[i];
   }
   return val;
 }
 
-int64_t bytes_to_int(const bytes &buffer) {
-  uint64_t tmp = bytes_to_uint(buffer);
+int64_t bytes_to_int(const bytes &buffer) { return bytes_to_int(buffer.data(), buffer.size()); }
+
+int64_t bytes_to_int(const uint8_t *buffer, size_t length) {
+  uint64_t tmp = bytes_to_uint(buffer, length);
   int64_t val;
 
-  switch (buffer.size()) {
+  switch (length) {
     case 1:  // int8
       val = (int8_t) tmp;
       break;
@@ -50,5 +50,9 @@ uint64_t bytes_to_uint(const bytes &buffer);
 int64_t bytes_to_int(const bytes &buffer);
 
 std::string bytes_to_string(const bytes &buffer);
+
+uint64_t bytes_to_uint(const uint8_t *buffer, size_t length);
+
+int64_t bytes_to_int(const uint8_t *buffer, size_t length);
 }  // namespace sml
 }  // namespace esphome
@@ -0,0 +1,267 @@
+#include "constants.h"
+#include "sml_parser.h"
+#include "sml_stream.h"
+
+namespace esphome {
+namespace sml {
+
+// two-bit mapping used by START_MASK and END_MASK
+static uint8_t escape_code(uint8_t byte) {
+  switch (byte) {
+    case 0x1b:
+      return 1;
+    case 0x01:
+      return 2;
+    case 0x1a:
+      return 3;
+    default:
+      return 0;
+  }
+}
+
+void SmlStreamDecoder::reset() {
+  this->state_ = STATE_HUNT;
+  this->mask_ = 0;
+  this->escape_count_ = 0;
+  this->trailer_pos_ = 0;
+  this->tl_bytes_ = 0;
+  this->value_remaining_ = 0;
+  this->capture_ = nullptr;
+  this->depth_ = 0;
+  this->message_type_ = 0;
+}
+
+SmlStreamEvent SmlStreamDecoder::start_telegram() {
+  this->reset();
+  this->crc_.reset();
+  this->state_ = STATE_DATA;
+  return SML_STREAM_START;
+}
+
+SmlStreamEvent SmlStreamDecoder::error() {
+  this->reset();
+  return SML_STREAM_ERROR;
+}
+
+SmlStreamEvent SmlStreamDecoder::flush_escape() {
+  SmlStreamEvent event = SML_STREAM_NONE;
+
+  while (this->escape_count_) {
+    this->escape_count_--;
+    SmlStreamEvent e = this->payload(0x1b);
+    if (e == SML_STREAM_ERROR)
+      return e;
+    if (e != SML_STREAM_NONE)
+      event = e;
+  }
+  return event;
+}
+
+SmlStreamEvent SmlStreamDecoder::push(uint8_t byte) {
+  SmlStreamEvent event;
+
+  // everything but the CRC itself is covered by the CRC
+  if (this->state_ != STATE_HUNT && (this->state_ != STATE_TRAILER || this->trailer_pos_ == 0))
+    this->crc_.update(byte);
+
+  switch (this->state_) {
+    case STATE_HUNT:
+      this->mask_ = (this->mask_ << 2) | escape_code(byte);
+      if (this->mask_ == START_MASK)
+        return this->start_telegram();
+      return SML_STREAM_NONE;
+
+    case STATE_DATA:
+      if (byte == 0x1b) {
+        if (++this->escape_count_ == 4) {
+          this->escape_count_ = 0;
+          this->state_ = STATE_ESCAPE;
+        }
+        return SML_STREAM_NONE;
+      }
+      // fewer than four 0x1b are plain payload
+      event = this->flush_escape();
+      if (event == SML_STREAM_ERROR)
+        return event;
+      {
+        SmlStreamEvent e = this->payload(byte);
+        return e != SML_STREAM_NONE ? e : event;
+      }
+
+    case STATE_ESCAPE:
+      switch (byte) {
+        case 0x1b:  // escaped 1b1b1b1b in the payload
+          this->escape_count_ = 1;
+          this->state_ = STATE_ESCAPE_DATA;
+          return SML_STREAM_NONE;
+        case 0x01:  // start sequence within a telegram, drop what we have
+          this->reset();
+          this->mask_ = 0x0156;  // 1b 1b 1b 1b 01
+          return SML_STREAM_ERROR;
+        case 0x1a:
+          this->trailer_pos_ = 0;
+          this->state_ = STATE_TRAILER;
+          return SML_STREAM_NONE;
+        default:
+          return this->error();
+      }
+
+    case STATE_ESCAPE_DATA:
+      if (byte != 0x1b)
+        return this->error();
+      if (++this->escape_count_ < 4)
+        return SML_STREAM_NONE;
+      this->state_ = STATE_DATA;
+      return this->flush_escape();
+
+    case STATE_TRAILER:
+      this->trailer_[this->trailer_pos_++] = byte;
+      if (this->trailer_pos_ < sizeof(this->trailer_))
+        return SML_STREAM_NONE;
+      this->reset();
+      return SML_STREAM_END;
+  }
+
+  return SML_STREAM_NONE;
+}
+
+SmlStreamEvent SmlStreamDecoder::payload(uint8_t byte) {
+  if (this->value_remaining_) {
+    this->capture(byte);
+    if (--this->value_remaining_)
+      return SML_STREAM_NONE;
+    return this->node_done();
+  }
+
+  if (this->tl_bytes_ == 0) {
+    if (byte == 0x00) {
+      if (this->depth_ == 0)
+        return SML_STREAM_NONE;  // fill byte between messages
+      return this->node_done();  // end of message, an empty value
+    }
+    this->tl_type_ = byte >> 4;
+    this->tl_length_ = byte & 0x0f;
+  } else {
+    this->tl_length_ = (this->tl_length_ << 4) | (byte & 0x0f);
+  }
+  if (++this->tl_bytes_ > 4)
+    return this->error();
+  if (byte & 0x80)
+    return SML_STREAM_NONE;  // more TL bytes follow
+
+  SmlStreamEvent event = this->node_begin();
+  this->tl_bytes_ = 0;
+  return event;
+}
+
+// The node being decoded sits at depth_, stack_[i].index is the position of
+// its ancestors (or itself for i == depth_ - 1) within their parent lists.
+bool SmlStreamDecoder::in_val_list(uint8_t depth) const {
+  return this->depth_ >= depth && depth >= 4 && this->message_type_ == SML_GET_LIST_RES &&
+         this->stack_[0].index == 3 &&  // message body
+         this->stack_[1].index == 1 &&  // GetListResponse
+         this->stack_[2].index == 4;    // valList
+}
+
+SmlStreamEvent SmlStreamDecoder::node_begin() {
+  uint8_t type = this->tl_type_ & 0x07;
+
+  if (this->depth_ == 0 && type != SML_LIST)
+    return this->error();
+
+  if (type == SML_LIST) {
+    if (this->depth_ == SML_STREAM_MAX_DEPTH || this->tl_length_ > UINT8_MAX)
+      return this->error();
+    if (this->depth_ == 0)
+      this->message_type_ = 0;
+    if (this->depth_ == 4 && this->in_val_list(4)) {
+      this->entry_.code_length = 0;
+      this->entry_.unit = 0;
+      this->entry_.scaler = 0;
+      this->entry_.value_type = SML_UNDEFINED;
+      this->entry_.value_length = 0;
+    }
+    if (this->depth_ == 5 && this->in_val_list(5) && this->stack_[4].index == 5)
+      this->entry_.value_type = SML_LIST;
+    if (this->tl_length_ == 0)
+      return this->node_done();
+    this->stack_[this->depth_].remaining = this->tl_length_;
+    this->stack_[this->depth_].index = 0;
+    this->depth_++;
+    return SML_STREAM_NONE;
+  }
+
+  if (this->tl_length_ < this->tl_bytes_)
+    return this->error();
+  this->value_remaining_ = this->tl_length_ - this->tl_bytes_;
+
+  this->capture_ = nullptr;
+  if (this->depth_ == 5 && this->in_val_list(5)) {
+    switch (this->stack_[4].index) {
+      case 0:  // objName
+        this->capture_ = this->entry_.code;
+        this->capture_max_ = sizeof(this->entry_.code);
+        this->capture_length_ = &this->entry_.code_length;
+        break;
+      case 3:  // unit
+      case 4:  // scaler
+        this->capture_ = this->scratch_;
+        this->capture_max_ = sizeof(this->scratch_);
+        this->capture_length_ = &this->scratch_length_;
+        break;
+      case 5:  // value
+        this->entry_.value_type = type;
+        this->capture_ = this->entry_.value;
+        this->capture_max_ = sizeof(this->entry_.value);
+        this->capture_length_ = &this->entry_.value_length;
+        break;
+    }
+  } else if (this->depth_ == 2 && this->stack_[0].index == 3 && this->stack_[1].index == 0) {
+    // message type
+    this->capture_ = this->scratch_;
+    this->capture_max_ = sizeof(this->scratch_);
+    this->capture_length_ = &this->scratch_length_;
+  }
+  if (this->capture_)
+    *this->capture_length_ = 0;
+
+  if (this->value_remaining_ == 0)
+    return this->node_done();
+  return SML_STREAM_NONE;
+}
+
+void SmlStreamDecoder::capture(uint8_t byte) {
+  if (!this->capture_ || *this->capture_length_ >= this->capture_max_)
+    return;
+  this->capture_[(*this->capture_length_)++] = byte;
+}
+
+SmlStreamEvent SmlStreamDecoder::node_done() {
+  SmlStreamEvent event = SML_STREAM_NONE;
+
+  if (this->capture_ == this->scratch_) {
+    if (this->depth_ == 2) {
+      this->message_type_ = bytes_to_uint(this->scratch_, this->scratch_length_);
+    } else if (this->stack_[4].index == 3) {
+      this->entry_.unit = bytes_to_uint(this->scratch_, this->scratch_length_);
+    } else {
+      this->entry_.scaler = bytes_to_int(this->scratch_, this->scratch_length_);
+    }
+  }
+  this->capture_ = nullptr;
+
+  while (this->depth_ > 0) {
+    Level &parent = this->stack_[this->depth_ - 1];
+    parent.index++;
+    if (--parent.remaining)
+      return event;
+    // parent list is complete as well
+    this->depth_--;
+    if (this->depth_ == 4 && this->in_val_list(4))
+      event = SML_STREAM_ENTRY;
+  }
+  return event;
+}
+
+}  // namespace sml
+}  // namespace esphome
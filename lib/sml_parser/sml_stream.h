@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstdint>
+#include "constants.h"
+
+namespace esphome {
+namespace sml {
+
+// Push style SML decoder. Bytes are fed one at a time as they arrive from the
+// meter; escape sequences, TL fields and list nesting are decoded on the fly
+// and every entry of a GetListResponse value list is reported as soon as its
+// last byte has been seen. Nothing is buffered besides the entry in progress.
+
+enum SmlStreamEvent : uint8_t {
+  SML_STREAM_NONE,
+  SML_STREAM_START,  // start escape sequence seen, a new telegram begins
+  SML_STREAM_ENTRY,  // a value list entry is complete, see entry()
+  SML_STREAM_END,    // end escape sequence and trailer seen, see crc_result()
+  SML_STREAM_ERROR,  // malformed telegram, waiting for the next start sequence
+};
+
+const uint8_t SML_STREAM_MAX_DEPTH = 16;
+const uint8_t SML_STREAM_MAX_VALUE = 8;
+const uint8_t SML_OBIS_CODE_LENGTH = 6;
+
+// CRC16 over the raw telegram, start sequence up to and including the fill
+// byte count. Meters use either X.25 or Kermit, both are tracked at once.
+class SmlCrc16 {
+ public:
+  // register values after the start sequence for X.25 (init 0xffff) and
+  // Kermit (init 0x0000)
+  void reset() {
+    this->x25_ = 0x91dc;
+    this->kermit_ = 0xed50;
+  }
+  void update(uint8_t byte) {
+    this->x25_ = (this->x25_ >> 8) ^ CRC16_X25_TABLE[(this->x25_ ^ byte) & 0xff];
+    this->kermit_ = (this->kermit_ >> 8) ^ CRC16_X25_TABLE[(this->kermit_ ^ byte) & 0xff];
+  }
+  Crc16CheckResult check(uint16_t received) const {
+    uint16_t x25 = this->x25_ ^ 0xffff;
+    if (received == static_cast<uint16_t>((x25 >> 8) | (x25 << 8)))
+      return CHECK_CRC16_X25_SUCCESS;
+    if (received == this->kermit_)
+      return CHECK_CRC16_KERMIT_SUCCESS;
+    return CHECK_CRC16_FAILED;
+  }
+
+ protected:
+  uint16_t x25_;
+  uint16_t kermit_;
+};
+
+class SmlObisEntry {
+ public:
+  uint8_t code[SML_OBIS_CODE_LENGTH];
+  uint8_t code_length;
+  char unit;
+  char scaler;
+  uint8_t value_type;
+  uint8_t value[SML_STREAM_MAX_VALUE];
+  uint8_t value_length;  // bytes stored in value, longer values are truncated
+};
+
+class SmlStreamDecoder {
+ public:
+  SmlStreamDecoder() { this->reset(); }
+
+  SmlStreamEvent push(uint8_t byte);
+  void reset();
+
+  bool in_telegram() const { return this->state_ != STATE_HUNT; }
+  const SmlObisEntry &entry() const { return this->entry_; }
+  // fill byte count followed by the CRC16 as sent by the meter
+  const uint8_t *trailer() const { return this->trailer_; }
+  // only meaningful right after SML_STREAM_END
+  Crc16CheckResult crc_result() const {
+    return this->crc_.check((uint16_t(this->trailer_[1]) << 8) | this->trailer_[2]);
+  }
+
+ protected:
+  enum State : uint8_t {
+    STATE_HUNT,         // looking for the start sequence
+    STATE_DATA,         // inside a telegram
+    STATE_ESCAPE,       // four escape bytes seen, next byte tells what follows
+    STATE_ESCAPE_DATA,  // escaped 1b1b1b1b in the payload
+    STATE_TRAILER,      // fill byte count and CRC after the end sequence
+  };
+
+  class Level {
+   public:
+    uint8_t remaining;  // children not yet complete
+    uint8_t index;      // index of the child currently decoded
+  };
+
+  SmlStreamEvent start_telegram();
+  SmlStreamEvent error();
+  SmlStreamEvent flush_escape();
+  SmlStreamEvent payload(uint8_t byte);
+  SmlStreamEvent node_begin();
+  SmlStreamEvent node_done();
+  bool in_val_list(uint8_t depth) const;
+  void capture(uint8_t byte);
+
+  State state_;
+  uint16_t mask_;
+  uint8_t escape_count_;
+  uint8_t trailer_[3];
+  uint8_t trailer_pos_;
+  SmlCrc16 crc_;
+
+  // TL field in progress
+  uint8_t tl_type_;
+  uint8_t tl_bytes_;
+  uint16_t tl_length_;
+
+  // value in progress
+  uint16_t value_remaining_;
+  uint8_t *capture_;
+  uint8_t capture_max_;
+  uint8_t *capture_length_;
+  uint8_t scratch_[SML_STREAM_MAX_VALUE];
+  uint8_t scratch_length_;
+
+  Level stack_[SML_STREAM_MAX_DEPTH];
+  uint8_t depth_;
+  uint16_t message_type_;
+
+  SmlObisEntry entry_;
+};
+
+}  // namespace sml
+}  // namespace esphome
@@ -52,6 +52,9 @@ def local_config(mapping_file, output_dir):
             "sleep_time_s" : j[chip]["sleep_time_s"],
             "ota_check_after" : j[chip]["ota_check_after"],
             "forced_data_after" : j[chip]["forced_data_after"],
+            "sample_buffer_words" : j[chip].get("sample_buffer_words", 0),
+            "wifi_resume" : j[chip].get("wifi_resume", True),
+            "tls_resume" : j[chip].get("tls_resume", True),
             "sensors" : sensors["sensors"],
         }
         with open(os.path.join(output_dir, "config.json.%s" % (chip)), "w") as f:
@@ -0,0 +1,140 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <DS18B20.h>
+#include <new>
+#include <Wire.h>
+
+#include "bus.h"
+
+I2CBus *I2CBus::active = nullptr;
+
+TwoWire *I2CBus::acquire() {
+    if (active != this) {
+        Wire.begin(sda, scl);
+        Wire.setClock(clock);
+        active = this;
+    }
+
+    start_us = micros();
+    return &Wire;
+}
+
+/*
+ * Devices are probed with an empty write the first time they are asked
+ * for, a full scan of the bus on every wake would cost more than it saves.
+ */
+bool I2CBus::has_device(uint8_t addr) {
+    uint8_t mask = 1 << (addr & 7);
+
+    addr &= 0x7f;
+    if (!(probed[addr >> 3] & mask)) {
+        TwoWire *wire = acquire();
+
+        wire->beginTransmission(addr);
+        if (!wire->endTransmission())
+            present[addr >> 3] |= mask;
+        probed[addr >> 3] |= mask;
+        release();
+    }
+
+    return present[addr >> 3] & mask;
+}
+
+I2CBus *BusManager::i2c(int8_t sda, int8_t scl, uint32_t clock) {
+    I2CBus *bus = nullptr;
+
+    if (clock > I2C_CLOCK_MAX)
+        clock = I2C_CLOCK_MAX;
+
+    for (uint8_t i = 0; i < num_i2c; i++) {
+        if (i2c_buses[i].sda == sda && i2c_buses[i].scl == scl) {
+            bus = &i2c_buses[i];
+            break;
+        }
+    }
+
+    if (!bus) {
+        if (num_i2c >= BUS_MAX_I2C) {
+            Serial.printf("bus: no I2C bus left for %d/%d\n", sda, scl);
+            return nullptr;
+        }
+        bus = &i2c_buses[num_i2c++];
+        bus->sda = sda;
+        bus->scl = scl;
+        bus->clock = clock ? clock : I2C_CLOCK_DEFAULT;
+    } else if (clock && clock < bus->clock) {
+        bus->clock = clock;
+        if (I2CBus::active == bus)
+            Wire.setClock(clock);
+    }
+
+    return bus;
+}
+
+void OneWireBus::begin(bool search) {
+    start_us = micros();
+    if (ds)
+        ds->~DS18B20();
+    ds = new (ds_storage) DS18B20(pin, search);
+    searched = search;
+    release();
+}
+
+OneWireBus *BusManager::onewire(int8_t pin, bool search) {
+    OneWireBus *bus;
+
+    for (uint8_t i = 0; i < num_onewire; i++) {
+        bus = &onewire_buses[i];
+        if (bus->pin != pin)
+            continue;
+        /* set up from a cache so far, nothing to select from */
+        if (search && !bus->searched)
+            bus->begin(true);
+        return bus;
+    }
+
+    if (num_onewire >= BUS_MAX_ONEWIRE) {
+        Serial.printf("bus: no OneWire bus left for %d\n", pin);
+        return nullptr;
+    }
+
+    bus = &onewire_buses[num_onewire++];
+    bus->pin = pin;
+    bus->begin(search);
+
+    return bus;
+}
+
+uint32_t BusManager::get_i2c_busy_us() {
+    uint32_t busy = 0;
+
+    for (uint8_t i = 0; i < num_i2c; i++)
+        busy += i2c_buses[i].get_busy_us();
+
+    return busy;
+}
+
+uint32_t BusManager::get_onewire_busy_us() {
+    uint32_t busy = 0;
+
+    for (uint8_t i = 0; i < num_onewire; i++)
+        busy += onewire_buses[i].get_busy_us();
+
+    return busy;
+}
+
+void BusManager::print_stats() {
+    for (uint8_t i = 0; i < num_i2c; i++)
+        Serial.printf("I2C %d/%d @ %u: busy %u us\n", i2c_buses[i].sda,
+                      i2c_buses[i].scl, i2c_buses[i].clock,
+                      i2c_buses[i].get_busy_us());
+
+    for (uint8_t i = 0; i < num_onewire; i++)
+        Serial.printf("OneWire %d: busy %u us\n", onewire_buses[i].pin,
+                      onewire_buses[i].get_busy_us());
+}
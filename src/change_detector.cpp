@@ -0,0 +1,186 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+
+#include "change_detector.h"
+#include "rtcmem.h"
+
+bool ChangeDetector::add_field(const JsonVariant &j, const char *name,
+                               float delta, float res) {
+    struct change_policy *p;
+    JsonVariant f;
+
+    if (num_fields >= CHANGE_MAX_FIELDS)
+        return false;
+
+    f = j["change"][name];
+    resolution[num_fields] = f["resolution"] | res;
+    if (!(resolution[num_fields] > 0))
+        resolution[num_fields] = res;
+    p = &policy[num_fields++];
+    p->delta = f["delta"] | delta;
+    p->percent = f["percent"] | NAN;
+    p->rate = f["rate"] | NAN;
+    p->level = f["level"] | NAN;
+    p->hysteresis = f["hysteresis"] | 0.;
+
+    if (p->rate > 0)
+        use_rate = true;
+
+    return true;
+}
+
+/* after all fields are known, the number of points is up to the sensor */
+void ChangeDetector::begin(const JsonVariant &j, uint8_t points) {
+    size_t values;
+
+    heartbeat_wakes = j["heartbeat"] | 0;
+    num_points = points;
+
+    values = num_points * num_fields;
+    rtc = (struct change_rtc_data *)rtcmem.alloc(RTCMEM_TAG_CHANGE,
+            sizeof(*rtc) + (use_rate ? 2 : 1) * values * sizeof(float));
+    if (!rtc)
+        return;
+
+    reported_values = (float *)(rtc + 1);
+    if (use_rate)
+        last_values = reported_values + values;
+
+    if (rtc->flags & CHANGE_INIT)
+        return;
+
+    /* nothing reported yet, the first values always go out */
+    for (size_t i = 0; i < (use_rate ? 2 : 1) * values; i++)
+        reported_values[i] = NAN;
+    rtc->flags = CHANGE_INIT;
+}
+
+bool ChangeDetector::check(uint8_t point, const float *values, uint8_t count) {
+    const float *ref;
+    float *last = nullptr;
+    float diff;
+    uint32_t bit;
+    bool changed = false;
+
+    /* without RTC memory there is nothing to compare with */
+    if (!rtc || point >= num_points)
+        return true;
+
+    ref = reported_values + point * num_fields;
+    if (last_values)
+        last = last_values + point * num_fields;
+
+    for (uint8_t i = 0; i < count && i < num_fields; i++) {
+        const struct change_policy &p = policy[i];
+        float v = values[i];
+
+        if (isnan(v))
+            continue;
+
+        diff = fabsf(v - ref[i]);
+        if (isnan(ref[i]) || diff >= p.delta)
+            changed = true;
+        if (p.percent > 0 && diff >= fabsf(ref[i]) * p.percent / 100)
+            changed = true;
+
+        if (last) {
+            if (p.rate > 0 && fabsf(v - last[i]) >= p.rate)
+                changed = true;
+            last[i] = v;
+        }
+
+        bit = point * num_fields + i;
+        if (isnan(p.level) || bit >= 32)
+            continue;
+        if (!(rtc->above & (1u << bit)) && v >= p.level + p.hysteresis / 2) {
+            rtc->above |= 1u << bit;
+            changed = true;
+        } else if ((rtc->above & (1u << bit)) &&
+                   v <= p.level - p.hysteresis / 2) {
+            rtc->above &= ~(1u << bit);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+bool ChangeDetector::heartbeat() {
+    if (!rtc)
+        return false;
+
+    if (rtc->silence < UINT16_MAX)
+        rtc->silence++;
+
+    return heartbeat_wakes && rtc->silence >= heartbeat_wakes;
+}
+
+void ChangeDetector::store(uint8_t point, const float *values, uint8_t count) {
+    if (!rtc || point >= num_points)
+        return;
+
+    memcpy(reported_values + point * num_fields, values,
+           min(count, num_fields) * sizeof(float));
+}
+
+int32_t ChangeDetector::quantise(uint8_t field, float v) {
+    float q;
+
+    if (field >= num_fields)
+        return 0;
+
+    q = roundf(v / resolution[field]);
+    if (q >= INT32_MAX)
+        return INT32_MAX;
+    if (q <= INT32_MIN)
+        return INT32_MIN;
+
+    return q;
+}
+
+float ChangeDetector::value(uint8_t field, int32_t q) {
+    if (field >= num_fields)
+        return NAN;
+
+    return q * resolution[field];
+}
+
+/* the values stored for point, nullptr if there are none */
+const float *ChangeDetector::reported(uint8_t point) {
+    if (!rtc || point >= num_points)
+        return nullptr;
+
+    return reported_values + point * num_fields;
+}
+
+void ChangeDetector::set_pending() {
+    if (!rtc)
+        return;
+
+    rtc->flags |= CHANGE_PENDING;
+    rtc->pending_wakes = 0;
+}
+
+bool ChangeDetector::age_pending() {
+    if (!pending())
+        return false;
+
+    if (++rtc->pending_wakes < CHANGE_MAX_PENDING_WAKES)
+        return true;
+
+    rtc->flags &= ~CHANGE_PENDING;
+    return false;
+}
+
+void ChangeDetector::published() {
+    if (!rtc)
+        return;
+
+    rtc->flags &= ~CHANGE_PENDING;
+    rtc->silence = 0;
+}
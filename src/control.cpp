@@ -17,47 +17,74 @@
 #include <time.h>
 
 #include "control.h"
-#include "rtcmem_map.h"
+#include "gzip.h"
+#include "rtcmem.h"
+#include "uart.h"
 #include "updater.h"
+#include "upload_queue.h"
 #include "version.h"
 
 #include "influxca.h"
 
 
+#define CONNECT_RESUME_MS   3000
+#define CONNECT_NETCFG_MS   5000
+#define CONNECT_SCAN_MS     10000
+
+static const char *connect_stage_names[] = { "resume", "netcfg", "scan" };
+
+static_assert(RTCMEM_RECORD_WORDS(sizeof(struct control_rtc_data)) <=
+              RTCMEM_BUDGET_CONTROL, "control data over RTC budget");
+static_assert(RTCMEM_RECORD_WORDS(sizeof(struct netcfg_rtc_data)) <=
+              RTCMEM_BUDGET_NET_CFG, "network config over RTC budget");
+static_assert(RTCMEM_RECORD_WORDS(sizeof(WiFiState)) <=
+              RTCMEM_BUDGET_WIFI_STATE, "WiFi state over RTC budget");
+
+static struct netcfg_rtc_data *netcfg_rtc() {
+    return (struct netcfg_rtc_data *)rtcmem.get(RTCMEM_TAG_NET_CFG,
+                                                 sizeof(netcfg_rtc_data));
+}
+
 NetCfg::NetCfg(bool load) {
+    struct netcfg_rtc_data *r;
+
     if (!load)
         return;
 
-    uint32_t mem;
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_MAGIC, &mem, sizeof(mem));
-    if (mem != 0xdeadbeef)
+    r = netcfg_rtc();
+    if (!r || r->magic != 0xdeadbeef)
         return;
 
     ok = true;
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_IP,    &this->ip_addr, sizeof(this->ip_addr));
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_MASK,  &this->netmask, sizeof(this->netmask));
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_GW,    &this->gateway, sizeof(this->gateway));
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_DNS,   &this->namesrv, sizeof(this->namesrv));
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_BSSID, (uint32_t *)&this->bssid, 8);
-    ESP.rtcUserMemoryRead(RTCMEM_NET_CFG_CHAN,  (uint32_t *)&this->chan, 4);
+    ip_addr = r->ip_addr;
+    netmask = r->netmask;
+    gateway = r->gateway;
+    namesrv = r->namesrv;
+    memcpy(bssid, r->bssid, sizeof(bssid));
+    chan = r->chan;
 }
 
 void NetCfg::save() {
+    struct netcfg_rtc_data *r = netcfg_rtc();
+
     ok = true;
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_IP,    &this->ip_addr, sizeof(this->ip_addr));
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_MASK,  &this->netmask, sizeof(this->netmask));
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_GW,    &this->gateway, sizeof(this->gateway));
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_DNS,   &this->namesrv, sizeof(this->namesrv));
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_BSSID, (uint32_t *)&this->bssid, 8);
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_CHAN,  (uint32_t *)&this->chan, 4);
-
-    uint32_t mem = 0xdeadbeef;
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_MAGIC, &mem, sizeof(mem));
+    if (!r)
+        return;
+
+    r->ip_addr = ip_addr;
+    r->netmask = netmask;
+    r->gateway = gateway;
+    r->namesrv = namesrv;
+    memcpy(r->bssid, bssid, sizeof(r->bssid));
+    r->chan = chan;
+    r->magic = 0xdeadbeef;
 }
 
 void NetCfg::clear() {
-    uint32_t mem = 0xffffffff;
-    ESP.rtcUserMemoryWrite(RTCMEM_NET_CFG_MAGIC, &mem, sizeof(mem));
+    struct netcfg_rtc_data *r = netcfg_rtc();
+
+    if (r)
+        r->magic = 0xffffffff;
 }
 
 void NetCfg::update() {
@@ -214,124 +241,319 @@ bool FirmwareControl::OTA() {
     return new_cfg || r > 0 ? true : false;
 }
 
-void FirmwareControl::publish_trace_data() {
-    Point point("trace_data");
-    point.addTag("device", device_name);
-    point.addTag("chip_id", chip_id);
-    point.addTag("firmware_version", VERSION);
-    point.setTime(time(nullptr));
-    point.addField("connect_time", connect_time);
-    ESP.rtcUserMemoryRead(RTCMEM_SAMPLE_TIME, &sample_time,
-			  sizeof(sample_time));
-    point.addField("sample_time", sample_time);
-    point.addTag("valid_net_cfg", valid_net_cfg ? "true" : "false");
-    Serial.println(influx->pointToLineProtocol(point));
-    influx->writePoint(point);
+void FirmwareControl::publish_trace_data(LineProtocol &lp) {
+    lp.begin("trace_data");
+    lp.tag("valid_net_cfg", valid_net_cfg ? "true" : "false");
+    if (connected_by < CONNECT_STAGES)
+        lp.tag("connect_stage", connect_stage_names[connected_by]);
+    lp.field_uint("connect_time", connect_time);
+    lp.field_uint("sample_time", rtc->sample_time);
+    lp.field_uint("i2c_busy_us",
+                  sensor_manager->get_bus_manager()->get_i2c_busy_us());
+    lp.field_uint("onewire_busy_us",
+                  sensor_manager->get_bus_manager()->get_onewire_busy_us());
+    lp.field_uint("connect_resume_ms", connect_stage_ms[CONNECT_RESUME]);
+    lp.field_uint("connect_netcfg_ms", connect_stage_ms[CONNECT_NETCFG]);
+    lp.field_uint("connect_scan_ms", connect_stage_ms[CONNECT_SCAN]);
+    lp.field_uint("tls_session_hits", tls_sessions.get_hits());
+    lp.field_uint("tls_session_misses", tls_sessions.get_misses());
+    lp.field_uint("lines_dropped", lp.get_dropped());
+    lp.end(time(nullptr));
+
+    sensor_manager->publish_stats(lp);
+}
+
+static void url_encode(String &dst, const char *s) {
+    static const char hex[] = "0123456789ABCDEF";
+
+    for (; *s; s++) {
+        if (isalnum(*s) || strchr("-_.~", *s)) {
+            dst += *s;
+        } else {
+            dst += '%';
+            dst += hex[(uint8_t)*s >> 4];
+            dst += hex[*s & 0xf];
+        }
+    }
+}
+
+/*
+ * The write URL and headers are put together once, the TLS session of the
+ * last wake and with it the MFLN probe result are taken from the cache.
+ */
+bool FirmwareControl::influx_setup() {
+    int start, end;
+    uint16_t port = 443;
+
+    if (strncmp(influx_url, "https://", 8)) {
+        Serial.println(F("Invalid influx_url, https required"));
+        return false;
+    }
+
+    influx_host = influx_url + 8;
+    end = influx_host.indexOf('/');
+    if (end >= 0)
+        influx_host.remove(end);
+    start = influx_host.indexOf(':');
+    if (start >= 0) {
+        port = influx_host.substring(start + 1).toInt();
+        influx_host.remove(start);
+    }
+
+    influx_write_url = influx_url;
+    influx_write_url += F("/api/v2/write?precision=s&org=");
+    url_encode(influx_write_url, influx_org);
+    influx_write_url += F("&bucket=");
+    url_encode(influx_write_url, influx_bucket);
+    influx_auth = F("Token ");
+    influx_auth += influx_token;
+
+    influx_client = new BearSSL::WiFiClientSecure;
+    influx_http = new HTTPClient;
+    if (!_cert)
+        _cert = new BearSSL::X509List(influxCA);
+    if (!influx_client || !influx_http || !_cert) {
+        Serial.println(F("OOM: could not allocate InfluxDB client"));
+        return false;
+    }
+
+    influx_client->setTrustAnchors(_cert);
+    influx_client->setSession(&influx_session);
+    /* a cached session also remembers the MFLN probe, saving a connection */
+    if (!tls_sessions.offer(influx_host.c_str(), influx_session, influx_mfln))
+        influx_mfln = influx_client->probeMaxFragmentLength(influx_host, port,
+                                                            1024);
+    if (influx_mfln)
+        influx_client->setBufferSizes(1024, 1024);
+
+    influx_http->setReuse(true);
+    influx_http->setTimeout(UPLOAD_TIMEOUT_MS);
+
+    return true;
+}
+
+/*
+ * Sends lines in chunks of whole lines and stops at the first chunk which
+ * fails. Returns the number of bytes the server did take. With influx_gzip
+ * chunks are larger and go out compressed, unless that does not save
+ * anything.
+ */
+size_t FirmwareControl::send_lines(const char *lines, size_t len) {
+    size_t chunk_size = UPLOAD_CHUNK_SIZE;
+    size_t n, pos = 0, gz_len = 0;
+    uint8_t *gz = nullptr;
+    int http_code;
+
+    if (!influx_http && !influx_setup())
+        return 0;
+
+    if (influx_gzip) {
+        chunk_size = UPLOAD_GZIP_CHUNK_SIZE;
+        gz = (uint8_t *)malloc(GZIP_BOUND(chunk_size));
+        if (!gz)
+            chunk_size = UPLOAD_CHUNK_SIZE;
+    }
+
+    while (pos < len) {
+        n = upload_chunk_len(lines + pos, len - pos, chunk_size);
+        if (gz && n <= chunk_size)
+            gz_len = gzip_compress((const uint8_t *)lines + pos, n, gz,
+                                   GZIP_BOUND(chunk_size));
+
+        if (!influx_http->begin(*influx_client, influx_write_url))
+            break;
+        influx_http->addHeader(F("Authorization"), influx_auth);
+        influx_http->addHeader(F("Content-Type"),
+                               F("text/plain; charset=utf-8"));
+        if (gz_len && gz_len < n) {
+            influx_http->addHeader(F("Content-Encoding"), F("gzip"));
+            http_code = influx_http->POST(gz, gz_len);
+        } else {
+            http_code = influx_http->POST((const uint8_t *)lines + pos, n);
+        }
+
+        if (http_code >= 0 && !influx_connected) {
+            influx_connected = true;
+            tls_sessions.update(influx_host.c_str(), influx_session,
+                                influx_mfln);
+        }
+        if (http_code != HTTP_CODE_NO_CONTENT) {
+            Serial.printf("InfluxDB write failed (%d): ", http_code);
+            if (http_code < 0)
+                Serial.println(HTTPClient::errorToString(http_code));
+            else
+                Serial.println(influx_http->getString());
+            influx_http->end();
+            break;
+        }
+        influx_http->end();
+        pos += n;
+        gz_len = 0;
+    }
+    free(gz);
+
+    return pos;
 }
 
+/*
+ * Data, statistics and trace data are put together as line protocol first.
+ * If the server can not be reached or a write fails, whatever was not taken
+ * goes to the upload queue instead of being retried for seconds on battery.
+ * Once a write went through, queued data is sent oldest first.
+ */
 void FirmwareControl::publish_data() {
-    uint8_t num_sensors;
-
-    num_sensors = sensor_manager->get_num_sensors();
-    influx = new InfluxDBClient(influx_url, influx_org, influx_bucket,
-                                influx_token, influxCA);
-    HTTPOptions opt;
-    opt.connectionReuse(true);
-    opt.httpReadTimeout(10000);
-    influx->setHTTPOptions(opt);
-    // NOTE: check batchSize with respect to num_sensors if there are memory
-    // consumption errors upcomming
-    influx->setWriteOptions(WriteOptions().writePrecision(WritePrecision::S).batchSize(num_sensors).bufferSize(2*num_sensors).maxRetryInterval(10));
-
-    if (influx->validateConnection()) {
-        Serial.print("Connected to InfluxDB: ");
-        Serial.println(influx->getServerUrl());
-    } else {
-        Serial.print("InfluxDB connection failed: ");
-        Serial.println(influx->getLastErrorMessage());
+    LineProtocol lp;
+    String queued;
+    size_t size, sent;
+    uint8_t n;
+
+    /* data points, trace data and one statistics point per sensor */
+    size = sensor_manager->get_num_points() +
+           sensor_manager->get_num_sensors() + 1;
+    size = min(size * LINE_PROTOCOL_POINT_SIZE,
+               (size_t)LINE_PROTOCOL_MAX_SIZE);
+    if (!lp.alloc(size)) {
+        Serial.println(F("OOM: could not allocate line protocol buffer"));
+        return;
+    }
+    lp.set_device(device_name.c_str(), chip_id, VERSION);
+
+    sensor_manager->publish(lp);
+    publish_trace_data(lp);
+    Serial.print(lp.c_str());
+
+    sent = send_lines(lp.c_str(), lp.length());
+    if (sent < lp.length()) {
+        Serial.printf("queueing %u bytes\n", lp.length() - sent);
+        queue.add(lp.c_str() + sent, lp.length() - sent);
+        return;
     }
 
-    sensor_manager->publish(influx, &device_name, chip_id, VERSION);
-    publish_trace_data();
-
-    influx_retry = 0;
-    while (!influx->isBufferEmpty() && influx_retry < 10) {
-        influx->flushBuffer();
-        Serial.print("InfluxDB flush failed: ");
-        Serial.println(influx->getLastErrorMessage());
-        Serial.print("Full buffer: ");
-        Serial.println(influx->isBufferFull() ? "Yes" : "No");
-        influx_retry++;
-        delay(1000);
+    for (n = 0; n < UPLOAD_QUEUE_DRAIN_SEGMENTS && queue.oldest(queued); n++) {
+        if (send_lines(queued.c_str(), queued.length()) < queued.length())
+            break;
+        queue.drop_oldest();
     }
 }
 
-void FirmwareControl::go_online() {
-    bool error = false;
+bool FirmwareControl::wait_connected(uint32_t timeout_ms) {
     int8_t status;
-    uint32_t tmp = 0, start_time = millis();
-    uint32_t sleep_factor = 1;
-
-    ESP.rtcUserMemoryWrite(RTCMEM_GO_ONLINE, &tmp, sizeof(tmp));
 
-    if (!rf_active)
-        goto sleep;
+    status = WiFi.waitForConnectResult(timeout_ms);
+    if (status != WL_CONNECTED) {
+        Serial.printf("Cannot connect (%d)!\n", status);
+        return false;
+    }
 
-    WiFi.persistent(false);
-    WiFi.setSleepMode(WIFI_NONE_SLEEP);
-    if (!WiFi.mode(WIFI_STA)) {
-        WiFi.mode(WIFI_OFF);
-        Serial.println("Cannot WIFI_STA!");
-        Serial.flush();
-        error = true;
+    if (!WiFi.localIP().isSet()) {
+        Serial.println("Cannot localIP!");
+        return false;
     }
 
-    this->netcfg = NetCfg(true);
-    valid_net_cfg = this->netcfg.valid();
-    if (!error && valid_net_cfg) {
-        Serial.println("... found valid network config");
-        Serial.flush();
+    return true;
+}
+
+/* one way of getting online, the time it took goes to the trace data */
+bool FirmwareControl::connect(enum connect_stage stage) {
+    uint32_t start_time = millis();
+    bool ok = false;
+
+    Serial.printf("Connecting (%s)\n", connect_stage_names[stage]);
+
+    switch (stage) {
+    case CONNECT_RESUME:
+        if (!wifi_state || !WiFi.resumeFromShutdown(*wifi_state)) {
+            Serial.println("Cannot resume!");
+            break;
+        }
+        ok = wait_connected(CONNECT_RESUME_MS);
+        break;
+
+    case CONNECT_NETCFG:
+        if (!valid_net_cfg)
+            break;
+        if (!WiFi.mode(WIFI_STA)) {
+            Serial.println("Cannot WIFI_STA!");
+            break;
+        }
         if (!WiFi.config(netcfg.IP(), netcfg.GW(), netcfg.Netmask(), netcfg.DNS())) {
-            error = true;
             Serial.println("Cannot config!");
-            Serial.flush();
+            break;
         }
-
-        if (!error && !WiFi.begin(wifi_ssid, wifi_pass, netcfg.channel(), netcfg.BSSID())) {
+        if (!WiFi.begin(wifi_ssid, wifi_pass, netcfg.channel(), netcfg.BSSID())) {
             Serial.println("Cannot begin from config!");
-            Serial.flush();
-            error = true;
+            break;
         }
-    } else if (!error && !WiFi.begin(wifi_ssid, wifi_pass)) {
-        Serial.println("Cannot begin!");
-        Serial.flush();
-        error = true;
-    }
+        ok = wait_connected(CONNECT_NETCFG_MS);
+        break;
 
-    status = WiFi.waitForConnectResult(10000);
-    if (!error && status != WL_CONNECTED) {
-        Serial.printf("Cannot connect (%d)!", status);
-        Serial.flush();
-        error = true;
+    case CONNECT_SCAN:
+        if (!WiFi.mode(WIFI_STA)) {
+            Serial.println("Cannot WIFI_STA!");
+            break;
+        }
+        /* back to DHCP after a failed static config */
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        if (!WiFi.begin(wifi_ssid, wifi_pass)) {
+            Serial.println("Cannot begin!");
+            break;
+        }
+        ok = wait_connected(CONNECT_SCAN_MS);
+        break;
+
+    default:
+        break;
     }
 
-    if (!error && !WiFi.localIP().isSet()) {
-        Serial.println("Cannot localIP!");
-        Serial.flush();
-        error = true;
+    connect_stage_ms[stage] = millis() - start_time;
+    if (ok)
+        connected_by = stage;
+    Serial.flush();
+
+    return ok;
+}
+
+/*
+ * The WiFi state of the last connection is resumed first, which skips
+ * association and DHCP. If it is gone or outdated, the network config of
+ * the last connection is tried and a scan with DHCP only after that.
+ */
+void FirmwareControl::go_online() {
+    uint32_t start_time = millis();
+    uint32_t sleep_factor = 1;
+    RFMode rf_mode = WAKE_RF_DEFAULT;
+
+    rtc->go_online = 0;
+
+    if (!rf_active) {
+        rtc->go_online = 1;
+        goto sleep;
     }
 
-    this->online = !error;
+    WiFi.persistent(false);
+    WiFi.setSleepMode(WIFI_NONE_SLEEP);
+
+    valid_net_cfg = this->netcfg.valid();
+    online = connect(CONNECT_RESUME) || connect(CONNECT_NETCFG) ||
+        connect(CONNECT_SCAN);
 
     if (!online) {
+        WiFi.mode(WIFI_OFF);
         netcfg.clear();
-        sleep_factor = 60;
+        if (wifi_state)
+            memset(wifi_state, 0, sizeof(*wifi_state));
         Serial.println(F("Failed to go online"));
+        /* the next wake samples before it asks to go online again, a
+         * pending change is updated meanwhile and given up eventually
+         */
+        sleep_factor = 60;
+        rf_mode = WAKE_RF_DISABLED;
 sleep:
-        tmp = 1;
-        ESP.rtcUserMemoryWrite(RTCMEM_GO_ONLINE, &tmp, sizeof(tmp));
+        sensor_manager->sleep(sleep_factor);
+        rtcmem.commit();
+        uart_release();
         Serial.flush();
-        ESP.deepSleepInstant(sleep_factor * 1E6, WAKE_RF_DEFAULT);
+        ESP.deepSleepInstant(sleep_factor * 1E6, rf_mode);
         delay(100);
     }
 
@@ -342,16 +564,18 @@ sleep:
 }
 
 void FirmwareControl::deep_sleep() {
+    uart_release();
     Serial.print(F(" -> deep sleep for "));
     Serial.println(sleep_time_s);
     Serial.flush();
 
-    ++reboot_count;
-    ESP.rtcUserMemoryWrite(RTCMEM_REBOOT_COUNTER, &reboot_count,
-                           sizeof(reboot_count));
+    rtc->reboot_count = ++reboot_count;
+    sensor_manager->sleep(sleep_time_s);
 
-    if (online)
+    /* the state ends up in RTC memory, so it goes before the commit */
+    if (online && (!wifi_state || !WiFi.shutdown(*wifi_state)))
         WiFi.mode(WIFI_OFF);
+    rtcmem.commit();
 
     ESP.deepSleepInstant(sleep_time_s * 1E6, WAKE_RF_DISABLED);
     delay(100);
@@ -384,6 +608,7 @@ void FirmwareControl::read_global_config() {
     influx_token = strdup(doc["influx_token"] | "ABCDEFG");
     influx_bucket = strdup(doc["influx_bucket"] | "sensor_bucket");
     influx_org = strdup(doc["influx_org"] | "influx org");
+    influx_gzip = doc["influx_gzip"] | false;
 
     ntp_server = strdup(doc["ntp_server"] | "pool.ntp.org");
 }
@@ -392,6 +617,8 @@ void FirmwareControl::read_config() {
     File file = LittleFS.open("/config.json", "r");
     StaticJsonDocument<1024> doc;
     JsonArray ja;
+    uint16_t buffer_words = 0;
+    uint16_t max_words = SAMPLE_BUFFER_MAX_WORDS;
 
     if (file) {
         DeserializationError error = deserializeJson(doc, file);
@@ -407,15 +634,33 @@ void FirmwareControl::read_config() {
         device_name = doc["device_name"] | chip_id;
         config_version = doc["config_version"] | 0;
 
+        buffer_words = doc["sample_buffer_words"] | 0;
         ja = doc["sensors"].as<JsonArray>();
-        sensor_manager = new SensorManager(ja);
     } else {
         ota_request = true;
         Serial.println(F("OTA Request: No local config found"));
         deserializeJson(doc, "{}");
         ja = doc.as<JsonArray>();
-        sensor_manager = new SensorManager(ja);
     }
+
+    /* both are worth most to a device going online on every wake, a
+     * buffering one may rather have the words for its samples
+     */
+    if (doc["wifi_resume"] | true)
+        wifi_state = (WiFiState *)rtcmem.get(RTCMEM_TAG_WIFI_STATE,
+                                             sizeof(*wifi_state));
+    else
+        max_words += RTCMEM_BUDGET_WIFI_STATE;
+    if (doc["tls_resume"] | true)
+        tls_sessions.begin();
+    else
+        max_words += RTCMEM_BUDGET_TLS_SESSIONS;
+
+    if (buffer_words > max_words) {
+        Serial.printf("Sample buffer limited to %u words\n", max_words);
+        buffer_words = max_words;
+    }
+    sensor_manager = new SensorManager(ja, buffer_words);
 }
 
 void FirmwareControl::setup() {
@@ -429,6 +674,14 @@ void FirmwareControl::setup() {
     Serial.println(ESP.getResetReason());
     LittleFS.begin();
 
+    /* the control records come first, they always fit. The WiFi state
+     * and the TLS session are large, read_config() asks for them if they
+     * are enabled, ahead of the sample buffer which takes what is left.
+     */
+    rtc = (struct control_rtc_data *)rtcmem.get(RTCMEM_TAG_CONTROL,
+                                                 sizeof(*rtc));
+    netcfg = NetCfg(true);
+
     read_global_config();
     read_config();
 
@@ -436,15 +689,10 @@ void FirmwareControl::setup() {
         Serial.print(F("OTA Request: "));
         Serial.println(ESP.getResetReason());
         ota_request = true;
-        reboot_count = 0;
-        ESP.rtcUserMemoryWrite(RTCMEM_REBOOT_COUNTER,
-                               &reboot_count,
-                               sizeof(reboot_count));
+        rtc->reboot_count = 0;
     }
 
-    ESP.rtcUserMemoryRead(RTCMEM_REBOOT_COUNTER,
-                          &reboot_count,
-                          sizeof(reboot_count));
+    reboot_count = rtc->reboot_count;
     if (!(reboot_count % ota_check_after)) {
         Serial.println("OTA Request: Reboot counter");
         ota_request = true;
@@ -457,11 +705,11 @@ void FirmwareControl::setup() {
 	force_update = true;
     }
 
-    uint32_t tmp;
-    ESP.rtcUserMemoryRead(RTCMEM_GO_ONLINE, &tmp, sizeof(tmp));
-    if (tmp) {
+    if (rtc->go_online) {
         rf_active = true;
         go_online_request = true;
+        if (sensor_manager->skip_sampling())
+            Serial.println(F("Samples buffered already, not sampling"));
     }
 
     int num_certs = cert_store.initCertStore(LittleFS, PSTR("/certs.idx"), PSTR("/certs.ar"));
@@ -480,8 +728,10 @@ void FirmwareControl::loop() {
 
     if (online && ota_request) {
         ota_effect = OTA();
-        if (ota_effect)
+        if (ota_effect) {
+            rtcmem.commit();
             ESP.reset();
+        }
 
         /* we did try OTA but either it had no effect or did fail,
          * either way we clear the request
@@ -498,12 +748,12 @@ void FirmwareControl::loop() {
         } else if (!go_online_request) {
             deep_sleep();
         } else {
-            ESP.rtcUserMemoryWrite(RTCMEM_SAMPLE_TIME, &sample_time,
-                                   sizeof(sample_time));
+            rtc->sample_time = sample_time;
 	}
     } else {
         start_time = millis();
         sensor_manager->loop();
+        delay(sensor_manager->idle_time());
         sample_time += millis() - start_time;
     }
 }
@@ -513,7 +763,6 @@ FirmwareControl::FirmwareControl() :
     influx_org(nullptr),
     influx_bucket(nullptr),
     influx_token(nullptr),
-    influx_retry(0),
     device_name("OWSF Sensor ESP8266"),
     sleep_time_s(600),
     config_version(0),
@@ -525,7 +774,6 @@ FirmwareControl::FirmwareControl() :
     ota_check_after(10000),
     forced_data_after(0),
     sensor_manager(nullptr),
-    influx(nullptr),
     connect_time(0),
     sample_time(0),
     valid_net_cfg(false)
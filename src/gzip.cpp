@@ -0,0 +1,179 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+
+#include "gzip.h"
+
+#define MIN_MATCH   3
+#define MAX_MATCH   258
+#define MAX_DIST    32768
+
+static const uint16_t len_base[] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258,
+};
+static const uint8_t len_extra[] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0,
+};
+static const uint16_t dist_base[] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+    16385, 24577,
+};
+static const uint8_t dist_extra[] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13,
+};
+
+struct bit_writer {
+    uint8_t *out;
+    size_t size;
+    size_t pos;
+    uint32_t bits;
+    uint8_t count;
+};
+
+/* deflate streams are filled from the least significant bit on */
+static void put_bits(struct bit_writer *w, uint32_t v, uint8_t n) {
+    w->bits |= v << w->count;
+    w->count += n;
+    while (w->count >= 8) {
+        if (w->pos < w->size)
+            w->out[w->pos] = w->bits;
+        w->pos++;
+        w->bits >>= 8;
+        w->count -= 8;
+    }
+}
+
+/* Huffman codes on the other hand go most significant bit first */
+static void put_code(struct bit_writer *w, uint32_t code, uint8_t n) {
+    uint32_t r = 0;
+
+    for (uint8_t i = 0; i < n; i++, code >>= 1)
+        r = (r << 1) | (code & 1);
+    put_bits(w, r, n);
+}
+
+/* symbol of the fixed literal/length code */
+static void put_symbol(struct bit_writer *w, uint16_t sym) {
+    if (sym < 144)
+        put_code(w, 0x30 + sym, 8);
+    else if (sym < 256)
+        put_code(w, 0x190 + sym - 144, 9);
+    else if (sym < 280)
+        put_code(w, sym - 256, 7);
+    else
+        put_code(w, 0xc0 + sym - 280, 8);
+}
+
+static void put_match(struct bit_writer *w, uint16_t len, uint16_t dist) {
+    uint8_t i;
+
+    for (i = sizeof(len_base) / sizeof(len_base[0]) - 1; len_base[i] > len; i--)
+        ;
+    put_symbol(w, 257 + i);
+    put_bits(w, len - len_base[i], len_extra[i]);
+
+    for (i = sizeof(dist_base) / sizeof(dist_base[0]) - 1; dist_base[i] > dist; i--)
+        ;
+    put_code(w, i, 5);
+    put_bits(w, dist - dist_base[i], dist_extra[i]);
+}
+
+static void put_le32(struct bit_writer *w, uint32_t v) {
+    for (uint8_t i = 0; i < 4; i++, v >>= 8)
+        put_bits(w, v & 0xff, 8);
+}
+
+/* the CRC-32 of gzip, reflected, a nibble at a time */
+static uint32_t gzip_crc32(const uint8_t *p, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc ^= *p++;
+        crc = (crc >> 4) ^ table[crc & 0xf];
+        crc = (crc >> 4) ^ table[crc & 0xf];
+    }
+
+    return ~crc;
+}
+
+static uint16_t hash3(const uint8_t *p) {
+    uint32_t v = p[0] | p[1] << 8 | p[2] << 16;
+
+    return (v * 2654435761u) >> (32 - GZIP_HASH_BITS);
+}
+
+size_t gzip_compress(const uint8_t *in, size_t len, uint8_t *out,
+                     size_t out_size) {
+    static const uint8_t header[] = {
+        0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff,
+    };
+    struct bit_writer w = {out, out_size, 0, 0, 0};
+    uint16_t *head;
+    size_t pos = 0, cand = 0, end, n, max;
+
+    if (len > GZIP_MAX_INPUT)
+        return 0;
+
+    /* positions plus one, zero is an empty slot */
+    head = (uint16_t *)calloc(1 << GZIP_HASH_BITS, sizeof(*head));
+    if (!head)
+        return 0;
+
+    for (uint8_t i = 0; i < sizeof(header); i++)
+        put_bits(&w, header[i], 8);
+
+    /* a single final block with the fixed codes */
+    put_bits(&w, 1, 1);
+    put_bits(&w, 1, 2);
+
+    while (pos < len) {
+        n = 0;
+        if (pos + MIN_MATCH <= len) {
+            uint16_t h = hash3(in + pos);
+
+            cand = head[h];
+            head[h] = pos + 1;
+            if (cand && pos - --cand <= MAX_DIST) {
+                max = min(len - pos, (size_t)MAX_MATCH);
+                while (n < max && in[cand + n] == in[pos + n])
+                    n++;
+            }
+        }
+
+        if (n < MIN_MATCH) {
+            put_symbol(&w, in[pos++]);
+            continue;
+        }
+
+        put_match(&w, n, pos - cand);
+        /* the positions skipped over are found again on the next line */
+        for (end = pos + n; ++pos < end; ) {
+            if (pos + MIN_MATCH <= len)
+                head[hash3(in + pos)] = pos + 1;
+        }
+    }
+    put_symbol(&w, 256);
+    if (w.count)
+        put_bits(&w, 0, 8 - w.count);
+
+    free(head);
+
+    put_le32(&w, gzip_crc32(in, len));
+    put_le32(&w, len);
+
+    return w.pos <= out_size ? w.pos : 0;
+}
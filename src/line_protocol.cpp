@@ -0,0 +1,192 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+
+#include "line_protocol.h"
+
+static const char MEASUREMENT_SPECIAL[] = ", ";
+static const char KEY_SPECIAL[] = ",= ";
+
+/* s appended to dst at n, returns the new length even if it did not fit */
+static size_t escape(char *dst, size_t n, size_t max, const char *s,
+                     const char *special) {
+    for (; *s; s++) {
+        if (strchr(special, *s)) {
+            if (n < max)
+                dst[n] = '\\';
+            n++;
+        }
+        if (n < max)
+            dst[n] = *s;
+        n++;
+    }
+
+    return n;
+}
+
+bool LineProtocol::alloc(size_t n) {
+    free(buf);
+    len = line_start = 0;
+    dropped = 0;
+
+    /* one more for the terminating zero */
+    buf = (char *)malloc(n + 1);
+    if (!buf) {
+        size = 0;
+        return false;
+    }
+    size = n;
+    buf[0] = 0;
+
+    return true;
+}
+
+void LineProtocol::put(char c) {
+    if (len < size)
+        buf[len++] = c;
+    else
+        overflow = true;
+}
+
+void LineProtocol::put(const char *s, size_t n) {
+    if (n > size - len) {
+        overflow = true;
+        return;
+    }
+    memcpy(buf + len, s, n);
+    len += n;
+}
+
+void LineProtocol::put_escaped(const char *s, const char *special) {
+    size_t n = escape(buf, len, size, s, special);
+
+    if (n > size) {
+        overflow = true;
+        n = size;
+    }
+    len = n;
+}
+
+/* at least digits digits, zero padded */
+void LineProtocol::put_uint(uint64_t v, uint8_t digits) {
+    char num[20];
+    uint8_t n = 0;
+
+    do {
+        num[n++] = '0' + v % 10;
+        v /= 10;
+    } while (v || n < digits);
+
+    while (n)
+        put(num[--n]);
+}
+
+void LineProtocol::set_device(const char *device, const char *chip_id,
+                              const char *version) {
+    static const char *const keys[] = {
+        ",device=", ",chip_id=", ",firmware_version=",
+    };
+    const char *values[] = {device, chip_id, version};
+    size_t n = 0;
+
+    for (uint8_t i = 0; i < 3; i++) {
+        if (!*values[i])
+            continue;
+        n = escape(prefix, n, sizeof(prefix), keys[i], "");
+        n = escape(prefix, n, sizeof(prefix), values[i], KEY_SPECIAL);
+    }
+
+    prefix_len = n;
+    if (n > sizeof(prefix)) {
+        Serial.println(F("device tags too long"));
+        prefix_len = 0;
+    }
+}
+
+void LineProtocol::begin(const char *measurement) {
+    line_start = len;
+    has_fields = false;
+    overflow = false;
+
+    put_escaped(measurement, MEASUREMENT_SPECIAL);
+    put(prefix, prefix_len);
+}
+
+/* tags have to come before the fields */
+void LineProtocol::tag(const char *key, const char *value) {
+    if (has_fields || !*value)
+        return;
+
+    put(',');
+    put_escaped(key, KEY_SPECIAL);
+    put('=');
+    put_escaped(value, KEY_SPECIAL);
+}
+
+/* NaN stands for a value that was not measured and is left out */
+void LineProtocol::field(const char *key, float value, uint8_t decimals) {
+    static const uint32_t scale[] = {1, 10, 100, 1000, 10000, 100000};
+    double v;
+    uint64_t n;
+
+    if (isnan(value) || isinf(value))
+        return;
+    if (decimals > 5)
+        decimals = 5;
+
+    put(has_fields ? ',' : ' ');
+    has_fields = true;
+    put_escaped(key, KEY_SPECIAL);
+    put('=');
+
+    v = value;
+    if (v < 0) {
+        put('-');
+        v = -v;
+    }
+    v = v * scale[decimals] + 0.5;
+    if (v >= 1e19) {
+        char num[48];
+
+        dtostrf(value < 0 ? -value : value, 0, decimals, num);
+        put(num, strlen(num));
+        return;
+    }
+    n = v;
+    put_uint(n / scale[decimals]);
+    if (decimals) {
+        put('.');
+        put_uint(n % scale[decimals], decimals);
+    }
+}
+
+void LineProtocol::field_uint(const char *key, uint32_t value) {
+    put(has_fields ? ',' : ' ');
+    has_fields = true;
+    put_escaped(key, KEY_SPECIAL);
+    put('=');
+    put_uint(value);
+    put('i');
+}
+
+void LineProtocol::end(uint32_t time_s) {
+    if (!buf)
+        return;
+
+    if (has_fields) {
+        put(' ');
+        put_uint(time_s);
+        put('\n');
+    }
+
+    if (overflow || !has_fields) {
+        len = line_start;
+        dropped++;
+    }
+    buf[len] = 0;
+    line_start = len;
+}
@@ -10,7 +10,6 @@
 
 #include "sensor.h"
 #include "control.h"
-#include "rtcmem_map.h"
 
 /* enable ADC and configure for external circuitry */
 ADC_MODE(ADC_TOUT);
@@ -25,5 +24,4 @@ void setup() {
 
 void loop() {
     ctrl.loop();
-    delay(100);
 }
@@ -0,0 +1,156 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <coredecls.h>
+
+#include "rtcmem.h"
+#include "version.h"
+
+#define HEADER_WORDS (sizeof(struct rtcmem_header) / 4)
+#define RECORD_WORDS (sizeof(struct rtcmem_record) / 4)
+
+RtcMem rtcmem;
+
+/* every build may lay out its records differently */
+static uint32_t firmware_hash() {
+    static const char v[] = VERSION " " BUILD_DATE;
+
+    return crc32(v, sizeof(v) - 1);
+}
+
+void RtcMem::reset() {
+    memset(image, 0, sizeof(image));
+    header()->magic = RTCMEM_MAGIC;
+    header()->version = firmware_hash();
+}
+
+void RtcMem::load() {
+    struct rtcmem_header *h = header();
+
+    if (loaded)
+        return;
+    loaded = true;
+
+    memset(requested, 0, sizeof(requested));
+    memset(next_instance, 0, sizeof(next_instance));
+
+    ESP.rtcUserMemoryRead(0, image, sizeof(image));
+    if (h->magic != RTCMEM_MAGIC || h->version != firmware_hash() ||
+        h->used > RTCMEM_WORDS - HEADER_WORDS ||
+        h->crc != crc32(image + HEADER_WORDS, h->used * 4)) {
+        Serial.println(F("RTC memory invalid, starting over"));
+        reset();
+    }
+}
+
+void *RtcMem::get(uint8_t tag, size_t size, uint8_t instance) {
+    struct rtcmem_header *h;
+    struct rtcmem_record *r;
+    uint16_t words = (size + 3) / 4;
+    uint16_t pos, end;
+
+    load();
+    h = header();
+    end = HEADER_WORDS + h->used;
+    for (pos = HEADER_WORDS; pos < end; pos += RECORD_WORDS + r->words) {
+        r = (struct rtcmem_record *)&image[pos];
+        if (r->tag != tag || r->instance != instance)
+            continue;
+        if (r->words == words) {
+            mark(pos);
+            return &image[pos + RECORD_WORDS];
+        }
+        /* same tag with a different size, the old record is dropped */
+        r->tag = RTCMEM_TAG_FREE;
+    }
+
+    if (end + RECORD_WORDS + words > RTCMEM_WORDS) {
+        Serial.printf("RTC memory full, record %u/%u not kept\n", tag,
+                      instance);
+        return nullptr;
+    }
+
+    r = (struct rtcmem_record *)&image[end];
+    r->tag = tag;
+    r->instance = instance;
+    r->words = words;
+    memset(&image[end + RECORD_WORDS], 0, words * 4);
+    h->used += RECORD_WORDS + words;
+    mark(end);
+
+    return &image[end + RECORD_WORDS];
+}
+
+void *RtcMem::alloc(uint8_t tag, size_t size) {
+    if (tag >= RTCMEM_TAG_COUNT)
+        return nullptr;
+
+    return get(tag, size, new_instance(tag));
+}
+
+uint8_t RtcMem::new_instance(uint8_t tag) {
+    load();
+    if (tag >= RTCMEM_TAG_COUNT)
+        return UINT8_MAX;
+
+    return next_instance[tag]++;
+}
+
+/* size in bytes, the record is kept like one from get() */
+void *RtcMem::find(uint8_t tag, uint8_t instance, size_t &size) {
+    struct rtcmem_record *r;
+    uint16_t pos, end;
+
+    load();
+    end = HEADER_WORDS + header()->used;
+    for (pos = HEADER_WORDS; pos < end; pos += RECORD_WORDS + r->words) {
+        r = (struct rtcmem_record *)&image[pos];
+        if (r->tag != tag || r->instance != instance)
+            continue;
+        mark(pos);
+        size = r->words * 4;
+        return &image[pos + RECORD_WORDS];
+    }
+
+    size = 0;
+    return nullptr;
+}
+
+/*
+ * Drop the records nobody asked for and write the image back in one go.
+ * Records move, pointers handed out before are only good for a second
+ * commit() after this.
+ */
+void RtcMem::commit() {
+    struct rtcmem_header *h;
+    struct rtcmem_record *r;
+    uint16_t pos, end, len, out = HEADER_WORDS;
+
+    load();
+    h = header();
+    end = HEADER_WORDS + h->used;
+    for (pos = HEADER_WORDS; pos < end; pos += len) {
+        r = (struct rtcmem_record *)&image[pos];
+        len = RECORD_WORDS + r->words;
+        if (!is_marked(pos))
+            continue;
+        if (out != pos)
+            memmove(&image[out], &image[pos], len * 4);
+        out += len;
+    }
+
+    memset(requested, 0, sizeof(requested));
+    for (pos = HEADER_WORDS; pos < out; pos += len) {
+        r = (struct rtcmem_record *)&image[pos];
+        len = RECORD_WORDS + r->words;
+        mark(pos);
+    }
+
+    h->used = out - HEADER_WORDS;
+    h->crc = crc32(image + HEADER_WORDS, h->used * 4);
+    ESP.rtcUserMemoryWrite(0, image, out * 4);
+}
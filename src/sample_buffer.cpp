@@ -0,0 +1,255 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+
+#include "rtcmem.h"
+#include "sample_buffer.h"
+
+/* the device time drifts, samples are not kept for longer than this */
+#define SAMPLE_BUFFER_MAX_AGE_S     (UINT16_MAX - 3600)
+
+#define SAMPLE_SENSOR   0x3f
+#define SAMPLE_TIME     0x40    /* time of the wake follows */
+#define SAMPLE_MASK     0x80    /* not all values present, mask follows */
+
+/* header, time, mask and values */
+#define SAMPLE_MAX_BYTES    (2 + 5 + 1 + 5 * SAMPLE_BUFFER_MAX_VALUES)
+
+static uint32_t zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static uint8_t put_varint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = v | 0x80;
+        v >>= 7;
+    }
+    p[n++] = v;
+
+    return n;
+}
+
+/* false if the stream ends in the middle */
+static bool get_varint(const uint8_t *p, uint16_t end, uint16_t &pos,
+                       uint32_t &v) {
+    uint8_t shift = 0;
+
+    v = 0;
+    while (pos < end && shift < 35) {
+        v |= (uint32_t)(p[pos] & 0x7f) << shift;
+        if (!(p[pos++] & 0x80))
+            return true;
+        shift += 7;
+    }
+
+    return false;
+}
+
+bool SampleBuffer::begin(uint16_t words) {
+    uint32_t *mem;
+    struct sample_entry e;
+    uint16_t n = 0;
+
+    if (!words)
+        return false;
+
+    mem = (uint32_t *)rtcmem.get(RTCMEM_TAG_SAMPLES,
+                                 sizeof(*hdr) + words * sizeof(uint32_t));
+    if (!mem) {
+        Serial.printf("No RTC memory for %u words of samples\n", words);
+        return false;
+    }
+
+    hdr = (struct sample_buffer_header *)mem;
+    data = (uint8_t *)(mem + sizeof(*hdr) / sizeof(uint32_t));
+    size = words * sizeof(uint32_t);
+    if (hdr->used > size) {
+        clear();
+        return true;
+    }
+
+    /* previous values and times are needed to append */
+    rewind();
+    while (next(e))
+        n++;
+    if (pos != hdr->used || n != hdr->entries)
+        clear();
+
+    return true;
+}
+
+static uint32_t device_time_ms(struct sample_buffer_header *hdr) {
+    return hdr->clock_ms + millis();
+}
+
+void SampleBuffer::reset() {
+    num_series = 0;
+    pos = 0;
+    time_s = 0;
+    interval_s = 0;
+}
+
+/* previous values of a series, zeros in scratch once the table is full */
+int32_t *SampleBuffer::find_series(uint8_t sensor, uint8_t point,
+                                   int32_t *scratch) {
+    struct sample_series *s;
+
+    for (uint8_t i = 0; i < num_series; i++) {
+        if (series[i].sensor == sensor && series[i].point == point)
+            return series[i].last;
+    }
+
+    if (num_series < SAMPLE_BUFFER_MAX_SERIES) {
+        s = &series[num_series++];
+        s->sensor = sensor;
+        s->point = point;
+        memset(s->last, 0, sizeof(s->last));
+        return s->last;
+    }
+
+    memset(scratch, 0, SAMPLE_BUFFER_MAX_VALUES * sizeof(int32_t));
+    return scratch;
+}
+
+bool SampleBuffer::add(uint8_t sensor, uint8_t point, const int32_t *values,
+                       uint8_t mask, uint8_t count) {
+    uint8_t buf[SAMPLE_MAX_BYTES];
+    int32_t scratch[SAMPLE_BUFFER_MAX_VALUES];
+    uint8_t num_series_old = num_series;
+    uint32_t t = time_s, interval = interval_s;
+    int32_t *last;
+    uint8_t n = 2;
+
+    if (!hdr || sensor > SAMPLE_SENSOR || point > 15 ||
+        count > SAMPLE_BUFFER_MAX_VALUES)
+        return false;
+
+    mask &= (1 << count) - 1;
+    buf[0] = sensor;
+    buf[1] = point << 4 | count;
+
+    if (!timed) {
+        if (!hdr->used)
+            hdr->base_ms = device_time_ms(hdr);
+        t = (device_time_ms(hdr) - hdr->base_ms) / 1000;
+        interval = hdr->used ? t - time_s : 0;
+        buf[0] |= SAMPLE_TIME;
+        n += put_varint(buf + n, zigzag(interval - interval_s));
+    }
+
+    if (mask != (1 << count) - 1) {
+        buf[0] |= SAMPLE_MASK;
+        buf[n++] = mask;
+    }
+
+    last = find_series(sensor, point, scratch);
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & (1 << i))
+            n += put_varint(buf + n, zigzag((uint32_t)values[i] - last[i]));
+    }
+
+    if (n > free_bytes()) {
+        num_series = num_series_old;
+        return false;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        if (mask & (1 << i))
+            last[i] = values[i];
+    }
+    memcpy(data + hdr->used, buf, n);
+    hdr->used += n;
+    hdr->entries++;
+    pos = hdr->used;
+    time_s = t;
+    interval_s = interval;
+    timed = true;
+
+    return true;
+}
+
+bool SampleBuffer::too_old() {
+    if (!hdr || !hdr->used)
+        return false;
+
+    return (device_time_ms(hdr) - hdr->base_ms) / 1000 >
+        SAMPLE_BUFFER_MAX_AGE_S;
+}
+
+void SampleBuffer::clear() {
+    if (!hdr)
+        return;
+
+    hdr->used = 0;
+    hdr->entries = 0;
+    reset();
+    timed = false;
+}
+
+void SampleBuffer::rewind() {
+    reset();
+}
+
+bool SampleBuffer::next(struct sample_entry &e) {
+    int32_t scratch[SAMPLE_BUFFER_MAX_VALUES];
+    int32_t *last;
+    uint32_t v;
+    uint8_t flags;
+
+    if (!hdr || pos + 2 > hdr->used)
+        return false;
+
+    flags = data[pos] & ~SAMPLE_SENSOR;
+    e.sensor = data[pos] & SAMPLE_SENSOR;
+    e.point = data[pos + 1] >> 4;
+    e.count = data[pos + 1] & 0x0f;
+    pos += 2;
+    if (e.count > SAMPLE_BUFFER_MAX_VALUES)
+        return false;
+
+    if (flags & SAMPLE_TIME) {
+        if (!get_varint(data, hdr->used, pos, v))
+            return false;
+        interval_s += unzigzag(v);
+        time_s += interval_s;
+    }
+
+    e.mask = (1 << e.count) - 1;
+    if (flags & SAMPLE_MASK) {
+        if (pos >= hdr->used)
+            return false;
+        e.mask &= data[pos++];
+    }
+
+    last = find_series(e.sensor, e.point, scratch);
+    for (uint8_t i = 0; i < e.count; i++) {
+        e.values[i] = 0;
+        if (!(e.mask & (1 << i)))
+            continue;
+        if (!get_varint(data, hdr->used, pos, v))
+            return false;
+        last[i] = (uint32_t)last[i] + unzigzag(v);
+        e.values[i] = last[i];
+    }
+
+    e.age_s = (device_time_ms(hdr) - hdr->base_ms) / 1000 - time_s;
+
+    return true;
+}
+
+void SampleBuffer::sleep(uint32_t sleep_s) {
+    if (!hdr)
+        return;
+
+    hdr->clock_ms += millis() + sleep_s * 1000;
+}
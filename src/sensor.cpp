@@ -7,88 +7,281 @@
 
 #include <Arduino.h>
 #include <time.h>
-#include <cfloat>
 
+#include "rtcmem.h"
 #include "sensor.h"
+#include "uart.h"
 
 /* sensor specific includes */
+#ifdef SENSOR_ADC
 #include "sensors/adc.h"
+#endif
+#ifdef SENSOR_BME280
 #include "sensors/bme280.h"
+#endif
+#ifdef SENSOR_DS18B20
 #include "sensors/ds18b20.h"
+#endif
+#ifdef SENSOR_SML
 #include "sensors/sml.h"
+#endif
+#ifdef SENSOR_VINDRIKTNING
 #include "sensors/vindriktning.h"
+#endif
 
-bool threshold_helper_float(float val_new, float val_old, float threshold)
-{
-    float val_diff;
-
-    if (isnan(val_old))
-	val_old = -FLT_MAX;
-    val_diff = val_new - val_old;
-    if (val_diff < 0)
-        val_diff *= -1;
-    if (val_diff >= threshold) {
-        return true;
-    } else {
-        return false;
-    }
+static constexpr sensor_driver drivers[] = {
+#ifdef SENSOR_ADC
+    { "ADC", sizeof(Sensor_ADC), alignof(Sensor_ADC),
+      Sensor_ADC::create },
+#endif
+#ifdef SENSOR_BME280
+    { "BME280", sizeof(Sensor_BME280), alignof(Sensor_BME280),
+      Sensor_BME280::create },
+#endif
+#ifdef SENSOR_DS18B20
+    { "DS18B20", sizeof(Sensor_DS18B20), alignof(Sensor_DS18B20),
+      Sensor_DS18B20::create },
+#endif
+#ifdef SENSOR_SML
+    { "SML", sizeof(Sensor_SML), alignof(Sensor_SML),
+      Sensor_SML::create },
+#endif
+#ifdef SENSOR_VINDRIKTNING
+    { "VINDRIKTNING", sizeof(Sensor_VINDRIKTNING), alignof(Sensor_VINDRIKTNING),
+      Sensor_VINDRIKTNING::create },
+#endif
+};
+
+static_assert(RTCMEM_RECORD_WORDS(sizeof(struct sensor_stats_rtc)) <=
+              RTCMEM_BUDGET_SENSOR_STATS, "sensor stats over RTC budget");
+
+/* the sensors of misc/templates/mapping.json.tmpl */
+#if defined(SENSOR_ADC) && defined(SENSOR_BME280)
+static_assert(ADC_RTCMEM_WORDS + BME280_RTCMEM_WORDS <= RTCMEM_BUDGET_SENSORS,
+              "template sensors over RTC budget");
+#endif
+
+static constexpr size_t max_driver_size() {
+    size_t size = 0;
+
+    for (const sensor_driver &d : drivers)
+        size = d.size > size ? d.size : size;
+
+    return size;
 }
 
-void SensorManager::register_sensor_class(const char *type, SensorFactory *sf) {
-    if (!type || !sf) {
-        Serial.printf("register_sensor_class: invalid parameters %p %p\n", type, sf);
-        return;
-    }
+static constexpr size_t max_driver_align() {
+    size_t align = 1;
 
-    Serial.printf("Registering factory %s -> %p\n", type, sf);
+    for (const sensor_driver &d : drivers)
+        align = d.align > align ? d.align : align;
 
-    factories[type] = sf;
+    return align;
 }
 
+/*
+ * Sensors live in static storage, one slot per sensor sized for the largest
+ * driver built in, so setting them up does not touch the heap. The slot size
+ * is a multiple of its alignment, so every slot is aligned, not just the
+ * first one.
+ */
+struct sensor_slot {
+    alignas(max_driver_align()) uint8_t mem[max_driver_size()];
+};
+
+static sensor_slot sensor_pool[SENSOR_MAX_SENSORS];
+
 void SensorManager::new_sensor(JsonVariant &j) {
-    SensorFactory *factory = nullptr;
+    const sensor_driver *driver = nullptr;
 
     if (j["type"].isNull())
         return;
 
     const char *type = j["type"].as<const char*>();
-    for (std::pair<const char *, SensorFactory *> f: factories) {
-        if (!strncasecmp(f.first, type, 64)) {
-            factory = f.second;
+    for (const sensor_driver &d : drivers) {
+        if (!strncasecmp(d.type, type, 64)) {
+            driver = &d;
             break;
         }
     }
 
-    if (!factory) {
-        Serial.printf("No factory for sensor type %s\n", type);
+    if (!driver) {
+        Serial.printf("No driver for sensor type %s\n", type);
         return;
     }
 
-    Sensor *sensor = factory->new_instance(j);
+    if (num_sensors >= SENSOR_MAX_SENSORS) {
+        Serial.printf("Too many sensors, ignoring %s\n", type);
+        return;
+    }
+
+    Sensor *sensor = driver->create(j, this, sensor_pool[num_sensors].mem);
     if (!sensor)
         return;
+    sensor->get_change().begin(j, sensor->get_num_points());
+
+    /* behind the last sensor on the same bus, at the end otherwise */
+    Bus *bus = sensor->get_bus();
+    uint8_t pos = num_sensors;
+    for (uint8_t k = 0; bus && k < num_sensors; k++) {
+        if (sensors[order[k]]->get_bus() == bus)
+            pos = k + 1;
+    }
+    memmove(&order[pos + 1], &order[pos], num_sensors - pos);
+    order[pos] = num_sensors;
+
+    sensors[num_sensors++] = sensor;
+}
+
+static uint8_t sat_add8(uint8_t a, uint32_t b) {
+    return b >= (uint32_t)(UINT8_MAX - a) ? UINT8_MAX : a + b;
+}
+
+static uint16_t sat_add16(uint16_t a, uint32_t b) {
+    return b >= (uint32_t)(UINT16_MAX - a) ? UINT16_MAX : a + b;
+}
+
+/* fold this wake into the statistics kept since the last upload */
+void SensorManager::save_stats() {
+    if (!stats)
+        return;
+
+    stats->wakes = sat_add16(stats->wakes, 1);
+    for (uint8_t i = 0; i < num_sensors; i++) {
+        const struct sensor_counters &c = sensors[i]->get_counters();
+        struct sensor_stats &s = stats->stats[i];
+
+        s.latency_ms = max(s.latency_ms, latency[i]);
+        s.polls = max(s.polls, polls[i]);
+        s.bytes_read = sat_add16(s.bytes_read, c.bytes_read);
+        s.checksum_errors = sat_add8(s.checksum_errors, c.checksum_errors);
+        s.resyncs = sat_add8(s.resyncs, c.resyncs);
+        s.bus_errors = sat_add8(s.bus_errors, c.bus_errors);
+    }
+}
+
+/*
+ * Run the change detection on everything measured during this wake. A sensor
+ * with a change keeps the values of all its points for the upload. While the
+ * upload is outstanding, newer values replace them, so an outage does not
+ * leave the node sending stale values. After a few wakes without a
+ * successful upload the change is given up and detection starts over.
+ */
+void SensorManager::detect_changes() {
+    float values[SAMPLE_BUFFER_MAX_VALUES];
+    uint8_t count;
+    bool changed;
 
-    sensors.push_back(sensor);
+    for (uint8_t n = 0; n < num_sensors; n++) {
+        Sensor *sensor = sensors[n];
+        ChangeDetector &change = sensor->get_change();
+
+        if (change.pending()) {
+            for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+                count = sensor->get_values(i, values);
+                if (count)
+                    change.store(i, values, count);
+            }
+            if (change.age_pending())
+                upload_request = true;
+            else
+                Serial.printf("%s: change not uploaded, giving up\n",
+                              sensor->get_sensor_type());
+            continue;
+        }
+
+        changed = change.heartbeat();
+        for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+            count = sensor->get_values(i, values);
+            if (count && change.check(i, values, count))
+                changed = true;
+        }
+        if (!changed)
+            continue;
+
+        for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+            count = sensor->get_values(i, values);
+            if (count)
+                change.store(i, values, count);
+        }
+        change.set_pending();
+        upload_request = true;
+    }
 }
 
-ADCFactory adc_factory;
-BME280Factory bme280_factory;
-DS18B20Factory ds18b20_factory;
-VINDRIKTNINGFactory vindriktning_factory;
-SMLFactory sml_factory;
+/* what was uploaded is what later values are compared with */
+void SensorManager::mark_published() {
+    float values[SAMPLE_BUFFER_MAX_VALUES];
+    uint8_t count;
+
+    for (uint8_t n = 0; n < num_sensors; n++) {
+        Sensor *sensor = sensors[n];
+        ChangeDetector &change = sensor->get_change();
 
-SensorManager::SensorManager(const JsonArray &j) {
+        for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+            count = sensor->get_values(i, values);
+            if (count)
+                change.store(i, values, count);
+        }
+        change.published();
+    }
+}
+
+/*
+ * Keep what was measured during this wake, quantised to the resolution of
+ * each field. The upload is requested once the next wake, which probably
+ * takes as many bytes as this one, would not fit anymore. A sensor with a
+ * change still goes online right away.
+ */
+void SensorManager::buffer_samples() {
+    float values[SAMPLE_BUFFER_MAX_VALUES];
+    int32_t q[SAMPLE_BUFFER_MAX_VALUES];
+    uint16_t used = buffer.get_used();
+    bool full = false;
+    uint8_t count, mask;
+
+    for (uint8_t n = 0; n < num_sensors; n++) {
+        Sensor *sensor = sensors[n];
+        ChangeDetector &change = sensor->get_change();
+
+        for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+            count = sensor->get_values(i, values);
+            if (!count)
+                continue;
+
+            mask = 0;
+            for (uint8_t k = 0; k < count; k++) {
+                if (isnan(values[k]))
+                    continue;
+                q[k] = change.quantise(k, values[k]);
+                mask |= 1 << k;
+            }
+
+            if (!buffer.add(n, i, q, mask, count)) {
+                Serial.printf("sample buffer full, %s point %u dropped\n",
+                              sensor->get_sensor_type(), i);
+                full = true;
+            }
+        }
+    }
+
+    if (full || buffer.free_bytes() < buffer.get_used() - used ||
+        buffer.too_old())
+        upload_request = true;
+}
+
+SensorManager::SensorManager(const JsonArray &j, uint16_t buffer_words) {
     num_sensors = 0;
-    bme280_factory.register_factory(this);
-    adc_factory.register_factory(this);
-    ds18b20_factory.register_factory(this);
-    vindriktning_factory.register_factory(this);
-    sml_factory.register_factory(this);
+    memset(latency, 0, sizeof(latency));
+    memset(polls, 0, sizeof(polls));
+    memset(finished, 0, sizeof(finished));
+    stats = (struct sensor_stats_rtc *)rtcmem.get(RTCMEM_TAG_SENSOR_STATS,
+                                                  sizeof(*stats));
+    buffer.begin(buffer_words);
 
     for (JsonVariant v : j) {
         Serial.printf("found sensor type %s\n", v["type"].as<const char *>());
         new_sensor(v);
-        num_sensors++;
     }
 
     Serial.println(F("SensorManger() done"));
@@ -98,41 +291,216 @@ bool SensorManager::upload_requested() {
     return upload_request;
 }
 
+/*
+ * The wake right after the one which asked for an upload only brings up the
+ * radio. Its samples are already buffered and just a second old, sampling
+ * again would upload a near duplicate of every point. Without a buffer the
+ * current values are published, so the sensors are sampled as usual.
+ */
+bool SensorManager::skip_sampling() {
+    if (!buffer.enabled() || !buffer.get_num_entries())
+        return false;
+
+    uart_release();
+    done = true;
+    upload_request = true;
+
+    return true;
+}
+
 bool SensorManager::sensors_done() {
     return done;
 }
 
+/* true if deadline a lies before b, millis() wraps after 49 days */
+static bool time_before(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) < 0;
+}
+
+/*
+ * Start all sensors on the first call, afterwards collect the results of
+ * those whose measurement should be ready. Conversions run in parallel, so
+ * sampling takes about as long as the slowest sensor.
+ */
 void SensorManager::loop() {
+    uint32_t now = millis();
+
+    if (!started) {
+        Serial.printf("Starting sensors ... \n");
+        for (uint8_t k = 0; k < num_sensors; k++)
+            sensors[order[k]]->start();
+        started = true;
+        start_time = now;
+    }
+
     done = true;
-    Serial.printf("Sampling ... \n");
-    for (Sensor *s : sensors) {
-        Sensor_State state = s->sample();
+    next_deadline = now;
+    for (uint8_t k = 0; k < num_sensors; k++) {
+        uint8_t i = order[k];
+        Sensor *s = sensors[i];
+        uint32_t ready;
+        Sensor_State state;
 
-        if (state == SENSOR_DONE_UPDATE)
-            upload_request = true;
+        /* whatever a finished sensor reports, it does not keep us awake */
+        if (finished[i])
+            continue;
 
-        if (state == SENSOR_INIT)
+        ready = s->ready_at();
+        if (time_before(now, ready)) {
+            if (done || time_before(ready, next_deadline))
+                next_deadline = ready;
             done = false;
+            continue;
+        }
+
+        state = s->sample();
+        polls[i] = sat_add8(polls[i], 1);
+
+        if (state == SENSOR_INIT) {
+            ready = s->ready_at();
+            if (done || time_before(ready, next_deadline))
+                next_deadline = ready;
+            done = false;
+            continue;
+        }
+
+        finished[i] = true;
+        latency[i] = sat_add16(0, millis() - start_time);
     }
+
+    if (done) {
+        uart_release();
+        buses.print_stats();
+        save_stats();
+        detect_changes();
+        if (buffer.enabled())
+            buffer_samples();
+    }
+}
+
+/* milliseconds until the next sensor wants to be sampled */
+uint32_t SensorManager::idle_time() {
+    uint32_t now = millis();
+
+    if (done || !time_before(now, next_deadline))
+        return 0;
+
+    return next_deadline - now;
 }
 
-void SensorManager::publish(InfluxDBClient *c, String *device_name,
-                            char *chip_id, const char *version) {
-    for (Sensor *sensor : sensors) {
-        Point point("sensor_data");
-        point.addTag("device", *device_name);
-        point.addTag("chip_id", chip_id);
-        point.addTag("firmware_version", version);
-        point.setTime(time(nullptr));
-        point.addTag("sensor_type", sensor->get_sensor_type());
-        if (sensor->get_tags() != "")
-            point.addTag("sensor_tags", sensor->get_tags());
-        sensor->publish(point);
-        Serial.println(c->pointToLineProtocol(point));
-        c->writePoint(point);
+/* measurement and tags of a sensor point */
+static void begin_point(LineProtocol &lp, const char *measurement,
+                        Sensor *sensor) {
+    lp.begin(measurement);
+    lp.tag("sensor_type", sensor->get_sensor_type());
+    lp.tag("sensor_tags", sensor->get_tags().c_str());
+}
+
+/* every buffered sample is written with the time it was taken */
+void SensorManager::publish_buffer(LineProtocol &lp) {
+    float values[SAMPLE_BUFFER_MAX_VALUES];
+    struct sample_entry e;
+    time_t now = time(nullptr);
+
+    buffer.rewind();
+    while (buffer.next(e)) {
+        if (e.sensor >= num_sensors)
+            continue;
+        Sensor *sensor = sensors[e.sensor];
+        ChangeDetector &change = sensor->get_change();
+
+        for (uint8_t k = 0; k < e.count; k++)
+            values[k] = e.mask & (1 << k) ? change.value(k, e.values[k]) : NAN;
+
+        begin_point(lp, "sensor_data", sensor);
+        sensor->publish_values(lp, e.point, values, e.count);
+        lp.end(now - e.age_s);
+    }
+
+    buffer.clear();
+}
+
+void SensorManager::publish(LineProtocol &lp) {
+    float values[SAMPLE_BUFFER_MAX_VALUES];
+    time_t now = time(nullptr);
+    const float *v;
+    uint8_t count;
+
+    if (buffer.enabled()) {
+        publish_buffer(lp);
+        mark_published();
+        return;
+    }
+
+    for (uint8_t n = 0; n < num_sensors; n++) {
+        Sensor *sensor = sensors[n];
+        ChangeDetector &change = sensor->get_change();
+
+        for (uint8_t i = 0; i < sensor->get_num_points(); i++) {
+            /* a change is uploaded with the values that triggered it */
+            if (change.pending()) {
+                v = change.reported(i);
+                count = change.get_num_fields();
+            } else {
+                v = values;
+                count = sensor->get_values(i, values);
+            }
+            if (!v || !count)
+                continue;
+
+            begin_point(lp, "sensor_data", sensor);
+            sensor->publish_values(lp, i, v, count);
+            lp.end(now);
+        }
+    }
+
+    mark_published();
+}
+
+/*
+ * One sensor_stats point per sensor, covering all wakes since the last
+ * upload. The statistics start over afterwards.
+ */
+void SensorManager::publish_stats(LineProtocol &lp) {
+    time_t now = time(nullptr);
+    char index[4];
+
+    if (!stats)
+        return;
+
+    for (uint8_t n = 0; n < num_sensors; n++) {
+        Sensor *sensor = sensors[n];
+        const struct sensor_stats &s = stats->stats[n];
+
+        begin_point(lp, "sensor_stats", sensor);
+        snprintf(index, sizeof(index), "%u", n);
+        lp.tag("sensor_index", index);
+        lp.field_uint("wakes", stats->wakes);
+        lp.field_uint("latency_ms", s.latency_ms);
+        lp.field_uint("polls", s.polls);
+        lp.field_uint("bytes_read", s.bytes_read);
+        lp.field_uint("checksum_errors", s.checksum_errors);
+        lp.field_uint("resyncs", s.resyncs);
+        lp.field_uint("bus_errors", s.bus_errors);
+        lp.end(now);
     }
+
+    memset(stats, 0, sizeof(*stats));
 }
 
 uint8_t SensorManager::get_num_sensors() {
     return num_sensors;
 }
+
+/* points written by publish() */
+uint16_t SensorManager::get_num_points() {
+    uint16_t n = 0;
+
+    if (buffer.enabled())
+        return buffer.get_num_entries();
+
+    for (uint8_t i = 0; i < num_sensors; i++)
+        n += sensors[i]->get_num_points();
+
+    return n;
+}
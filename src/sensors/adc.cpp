@@ -10,47 +10,36 @@ extern "C" {
     #include "user_interface.h"
 }
 
-Sensor_ADC::Sensor_ADC(const JsonVariant &j) : current_value(0), mem(-1),
-	data_upload(false) {
-    int rtcmem;
-
+Sensor_ADC::Sensor_ADC(const JsonVariant &j) : current_value(0) {
     r1 = j["R1"] | 9100.;
     r2 = j["R2"] | 47000.;
     offset = j["offset"] | 0.;
     factor = j["factor"] | 1.;
 
-    threshold_voltage = j["threshold_voltage"] | 0.01;
-
-    rtcmem = j["rtcmem_slot"] | -1;
-    mem = RTCMEM_SENSOR(rtcmem);
+    change.add_field(j, "voltage", j["threshold_voltage"] | 0.01, 0.001);
 
     tags = j["tags"] | "";
+}
+
+uint8_t Sensor_ADC::get_values(uint8_t, float *values) {
+    if (!measured)
+        return 0;
 
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    if (rtc_data.data_upload == 0xdeadbeef) {
-        rtc_data.data_upload = 0;
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data,
-			       sizeof(rtc_data));
-        data_upload = true;
-        return;
-    }
+    values[0] = current_value;
+    return 1;
 }
 
-void Sensor_ADC::publish(Point &p) {
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    rtc_data.data_upload = 0;
-    ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    p.addField("voltage", rtc_data.current_value);
+void Sensor_ADC::publish_values(LineProtocol &p, uint8_t,
+                                const float *values, uint8_t count) {
+    if (count >= 1)
+        p.field("voltage", values[0]);
 }
 
 Sensor_State Sensor_ADC::sample() {
     uint32_t adc_val;
     if (state != SENSOR_INIT)
         return state;
-    state = SENSOR_DONE_NOUPDATE;
-
-    if (data_upload)
-	return SENSOR_DONE_UPDATE;
+    state = SENSOR_DONE;
 
     Serial.printf("  Sampling sensor ADC\n");
 
@@ -63,24 +52,7 @@ Sensor_State Sensor_ADC::sample() {
     system_soft_wdt_restart();
 
     current_value = factor * (1. * adc_val) * (1 + r1 / r2) / 1024 + offset;
-
-    if (mem < 0) {
-        state = SENSOR_DONE_UPDATE;
-        return state;
-    }
-
-    state = SENSOR_DONE_NOUPDATE;
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    if (threshold_helper_float(current_value, rtc_data.current_value,
-			       threshold_voltage)) {
-        state = SENSOR_DONE_UPDATE;
-	rtc_data.data_upload = 0xdeadbeef;
-	data_upload = true;
-	rtc_data.current_value = current_value;
-    } else {
-	    rtc_data.data_upload = 0;
-    }
-    ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
+    measured = true;
 
     return state;
 }
@@ -5,14 +5,86 @@
  *
  */
 
-#include <Wire.h>
-
 #include "sensors/bme280.h"
 
+/* 0, 1, 2, 4, 8, 16 -> osrs_x register value */
+static uint8_t oversampling(uint8_t n) {
+    uint8_t osrs = 0;
+
+    while (n && osrs < BME280_OSRS_X16) {
+        osrs++;
+        n >>= 1;
+    }
+
+    return osrs;
+}
+
+/*
+ * Address and calibration are found out after power on and kept in RTC
+ * memory, later wakes do not touch the chip before the first measurement.
+ */
+bool Sensor_BME280::load_calibration() {
+    bool ok;
+
+    if (calib && calib->addr && (!addr || calib->addr == addr)) {
+        addr = calib->addr;
+        bme.set_address(addr);
+        return bme.begin(calib->raw);
+    }
+
+    if (!addr) {
+        if (bus->has_device(BME280_ADDR_PRIMARY))
+            addr = BME280_ADDR_PRIMARY;
+        else if (bus->has_device(BME280_ADDR_SECONDARY))
+            addr = BME280_ADDR_SECONDARY;
+        else
+            return false;
+    }
+    bme.set_address(addr);
+
+    bus->acquire();
+    ok = bme.begin();
+    bus->release();
+    if (!ok)
+        return false;
+
+    if (calib) {
+        calib->addr = addr;
+        memcpy(calib->raw, bme.get_calibration(), sizeof(calib->raw));
+    }
+
+    return true;
+}
+
+/* a forced measurement is started, the chip sleeps again once it is done */
+void Sensor_BME280::start() {
+    bool ok;
+
+    if (!initialized)
+        return;
+
+    bus->acquire();
+    ok = bme.start();
+    bus->release();
+    if (!ok) {
+        Serial.printf("  BME280 cannot start measurement\n");
+        counters.bus_errors++;
+        return;
+    }
+    conversion_done = millis() + (bme.measurement_time_us() + 999) / 1000;
+}
+
+uint32_t Sensor_BME280::ready_at() {
+    return conversion_done;
+}
+
 Sensor_State Sensor_BME280::sample() {
+    bme280_data data;
+    bool ok;
+
     if (state != SENSOR_NOT_INIT && state != SENSOR_INIT)
         return state;
-    state = SENSOR_DONE_NOUPDATE;
+    state = SENSOR_DONE;
 
     Serial.printf("  Sampling sensor BME280\n");
     if (!initialized) {
@@ -20,96 +92,72 @@ Sensor_State Sensor_BME280::sample() {
         return SENSOR_NOT_INIT;
     }
 
-    if (data_upload)
-	return SENSOR_DONE_UPDATE;
-
-    Wire.begin(sda, scl);
-    bme.takeForcedMeasurement();
-    pres = bme.readPressure() / 100.;
-    hum = bme.readHumidity();
-    temp = bme.readTemperature();
-
-    if (mem < 0) {
-        state = SENSOR_DONE_UPDATE;
+    bus->acquire();
+    ok = bme.read(&data);
+    bus->release();
+    if (!ok) {
+        Serial.printf("  BME280 read failed\n");
+        counters.bus_errors++;
         return state;
     }
-
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    if (threshold_helper_float(pres, rtc_data.pres, threshold_pres)) {
-        state = SENSOR_DONE_UPDATE;
-	rtc_data.pres = pres;
-    }
-    if (threshold_helper_float(hum, rtc_data.hum, threshold_hum)) {
-        state = SENSOR_DONE_UPDATE;
-	rtc_data.hum = hum;
-    }
-    if (threshold_helper_float(temp, rtc_data.temp, threshold_temp)) {
-        state = SENSOR_DONE_UPDATE;
-	rtc_data.temp = temp;
-    }
-    if (state == SENSOR_DONE_UPDATE) {
-	rtc_data.data_upload = 0xdeadbeef;
-    } else {
-	rtc_data.data_upload = 0;
-    }
-    ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
+    temp = data.temp / 100.;
+    pres = data.pres / 25600.;
+    hum = data.hum / 1024.;
+    measured = true;
 
     return state;
 }
 
-void Sensor_BME280::publish(Point &p) {
-    if (!initialized)
+uint8_t Sensor_BME280::get_values(uint8_t, float *values) {
+    if (!measured)
+        return 0;
+
+    values[0] = temp;
+    values[1] = hum;
+    values[2] = pres;
+    return 3;
+}
+
+void Sensor_BME280::publish_values(LineProtocol &p, uint8_t,
+                                   const float *values, uint8_t count) {
+    if (count < 3)
         return;
 
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    rtc_data.data_upload = 0;
-    ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    p.addField("temperature", rtc_data.temp);
-    p.addField("humidity", rtc_data.hum);
-    p.addField("pressure", rtc_data.pres);
+    p.field("temperature", values[0]);
+    p.field("humidity", values[1]);
+    p.field("pressure", values[2]);
 }
 
-Sensor_BME280::Sensor_BME280(const JsonVariant &j) :
-    temp(21.), hum(50.), pres(1080.), bme(), mem(-1), data_upload(false)
+Sensor_BME280::Sensor_BME280(const JsonVariant &j, BusManager *buses) :
+    addr(0), temp(21.), hum(50.), pres(1080.), bus(nullptr),
+    bme(&Wire, BME280_ADDR_PRIMARY), calib(nullptr)
 {
-    int rtcmem;
-
     Serial.println(F("Initializing BME280 "));
 
     initialized = false;
     sda = j["sda"] | 2;
     scl = j["scl"] | 14;
+    /* 0 means probe 0x76 and 0x77 */
+    addr = j["addr"] | 0;
+
+    /* in the order of get_values() */
+    change.add_field(j, "temperature", j["threshold_temp"] | 0.3, 0.01);
+    change.add_field(j, "humidity", j["threshold_hum"] | 0.5, 0.01);
+    change.add_field(j, "pressure", j["threshold_pres"] | 5.0, 0.01);
 
-    threshold_pres = j["threshold_pres"] | 5.0;
-    threshold_hum = j["threshold_hum"] | 0.5;
-    threshold_temp = j["threshold_temp"] | 0.3;
+    bme.set_oversampling(oversampling(j["oversampling_temp"] | 1),
+                         oversampling(j["oversampling_pres"] | 1),
+                         oversampling(j["oversampling_hum"] | 1));
 
-    rtcmem = j["rtcmem_slot"] | -1;
-    mem = RTCMEM_SENSOR(rtcmem);
+    calib = (bme280_calib_cache *)rtcmem.alloc(RTCMEM_TAG_BME280_CALIB,
+                                               sizeof(*calib));
 
     tags = j["tags"] | "";
 
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    if (rtc_data.data_upload == 0xdeadbeef) {
-	rtc_data.data_upload = 0;
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	data_upload = true;
-	initialized = true;
-	return;
-    }
-    Wire.begin(sda, scl);
-    delay(500);
-    if (!bme.begin(addr, &Wire))
+    bus = buses->i2c(sda, scl, j["i2c_clock"] | 0);
+    if (!bus || !load_calibration())
         return;
 
-    delay(500);
-    bme.setSampling(Adafruit_BME280::MODE_FORCED,
-                    Adafruit_BME280::SAMPLING_X1, // temperature
-                    Adafruit_BME280::SAMPLING_X1, // pressure
-                    Adafruit_BME280::SAMPLING_X1, // humidity
-                    Adafruit_BME280::FILTER_OFF);
-    delay(500);
-
     initialized = true;
 }
 
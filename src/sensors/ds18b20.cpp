@@ -7,62 +7,227 @@
  */
 
 #include "sensors/ds18b20.h"
+extern "C" {
+    #include "user_interface.h"
+}
+
+/*
+ * The ROM IDs found by the last search are used as long as the cache is
+ * intact, the chip woke up from deep sleep and rescan_after wakes have not
+ * passed yet. Anything else (power on, reset, RTC memory lost) means a search.
+ */
+bool Sensor_DS18B20::load_rom_cache(BusManager *buses, uint8_t pin) {
+    if (!rom_cache)
+        return false;
+
+    if (ESP.getResetInfoPtr()->reason != REASON_DEEP_SLEEP_AWAKE)
+        return false;
+
+    if (!rom_cache->num_probes || rom_cache->num_probes > DS18B20_CACHE_PROBES ||
+        rom_cache_size != sizeof(*rom_cache) +
+        rom_cache->num_probes * sizeof(rom_cache->rom[0]) ||
+        !rom_cache->wakes_left)
+        return false;
+
+    /* configured resolution changed, the probes need to be written */
+    if (resolution && rom_cache->resolution != resolution)
+        return false;
+
+    bus = buses->onewire(pin, false);
+    if (!bus)
+        return false;
+    ds = bus->acquire();
+    ds->restoreBus(rom_cache->resolution, rom_cache->power_mode,
+                   rom_cache->num_probes);
+    bus->release();
+
+    num_probes = rom_cache->num_probes;
+    memcpy(rom, rom_cache->rom, num_probes * sizeof(rom[0]));
+    for (uint8_t i = 0; i < num_probes; i++)
+        temp[i] = NAN;
+
+    rom_cache->wakes_left--;
+
+    return true;
+}
+
+void Sensor_DS18B20::save_rom_cache(uint8_t wakes) {
+    if (num_probes > DS18B20_CACHE_PROBES) {
+        Serial.printf("  DS18B20 too many probes to cache\n");
+        invalidate_rom_cache();
+        return;
+    }
+
+    /* a different number of probes replaces the record */
+    rom_cache_size = sizeof(*rom_cache) + num_probes * sizeof(rom_cache->rom[0]);
+    rom_cache = (ds18b20_rom_cache *)rtcmem.get(RTCMEM_TAG_DS18B20_ROMS,
+                                                rom_cache_size,
+                                                rom_cache_instance);
+    if (!rom_cache)
+        return;
+
+    rom_cache->num_probes = num_probes;
+    rom_cache->resolution = ds->getGlobalResolution();
+    rom_cache->power_mode = ds->getGlobalPowerMode();
+    rom_cache->wakes_left = wakes;
+    memcpy(rom_cache->rom, rom, num_probes * sizeof(rom[0]));
+}
+
+void Sensor_DS18B20::invalidate_rom_cache() {
+    if (rom_cache)
+        rom_cache->num_probes = 0;
+}
+
+/*
+ * Search the bus. Probes which do not run at the configured resolution are
+ * reconfigured, this ends up in their EEPROM so it only happens once.
+ */
+void Sensor_DS18B20::scan(BusManager *buses, uint8_t pin) {
+    bus = buses->onewire(pin);
+    if (!bus)
+        return;
+
+    ds = bus->acquire();
+    while (num_probes < DS18B20_MAX_PROBES && ds->selectNext()) {
+        if (resolution && ds->getResolution() != resolution) {
+            Serial.printf("  DS18B20 probe %u: %u -> %u bit\n", num_probes,
+                          ds->getResolution(), resolution);
+            ds->setResolution(resolution);
+        }
+        ds->getAddress(rom[num_probes]);
+        temp[num_probes] = NAN;
+        num_probes++;
+    }
+    if (resolution)
+        ds->restoreBus(resolution, ds->getGlobalPowerMode(), num_probes);
+    bus->release();
+    Serial.printf("  found %u probes\n", num_probes);
+
+    if (num_probes)
+        save_rom_cache(rescan_after);
+    else
+        invalidate_rom_cache();
+}
+
+/*
+ * All probes on the bus convert at the same time, afterwards the scratchpad
+ * of each probe is read by ROM ID. A bus with ten probes takes one
+ * conversion time instead of ten, and other sensors are sampled meanwhile.
+ */
+void Sensor_DS18B20::start() {
+    if (!initialized)
+        return;
+
+    bus->acquire();
+    ds->startConversion();
+    bus->release();
+    if (ds->getGlobalPowerMode())
+        next_poll = millis() + DS18B20_POLL_MS;
+    else
+        next_poll = ds->conversionReadyAt();
+}
+
+uint32_t Sensor_DS18B20::ready_at() {
+    return next_poll;
+}
 
 Sensor_State Sensor_DS18B20::sample() {
+    bool ready, ok;
+
     if (state != SENSOR_NOT_INIT && state != SENSOR_INIT)
         return state;
-    state = SENSOR_DONE_NOUPDATE;
 
-    Serial.printf("  Sampling sensor DS18B20\n");
     if (!initialized) {
         Serial.printf("  DS18B20 not initialized");
         return SENSOR_NOT_INIT;
     }
 
-    temp = ds->getTempC();
-
-    if (mem < 0) {
-        state = SENSOR_DONE_UPDATE;
+    bus->acquire();
+    ready = ds->isReady();
+    bus->release();
+    if (!ready) {
+        next_poll = millis() + DS18B20_POLL_MS;
+        state = SENSOR_INIT;
         return state;
     }
 
-    ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-    if (threshold_helper_float(temp, rtc_data.temp, threshold_temp)) {
-        state = SENSOR_DONE_UPDATE;
-	rtc_data.temp = temp;
+    Serial.printf("  Sampling sensor DS18B20\n");
+    state = SENSOR_DONE;
+
+    for (uint8_t i = 0; i < num_probes; i++) {
+        bus->acquire();
+        ok = ds->readTempC(rom[i], &temp[i]);
+        bus->release();
+        if (!ok) {
+            Serial.printf("  DS18B20 probe %u: read failed\n", i);
+            counters.bus_errors++;
+            /* the probe might be gone, search again on the next wake */
+            invalidate_rom_cache();
+            temp[i] = NAN;
+        }
     }
-    ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
 
     return state;
 }
 
-void Sensor_DS18B20::publish(Point &p) {
-    if (!initialized)
+uint8_t Sensor_DS18B20::get_num_points() {
+    return num_probes;
+}
+
+uint8_t Sensor_DS18B20::get_values(uint8_t idx, float *values) {
+    if (!initialized || idx >= num_probes || isnan(temp[idx]))
+        return 0;
+
+    values[0] = temp[idx];
+    return 1;
+}
+
+void Sensor_DS18B20::publish_values(LineProtocol &p, uint8_t idx,
+                                    const float *values, uint8_t count) {
+    char rom_id[17];
+
+    if (!initialized || idx >= num_probes)
         return;
 
-    p.addField("temperature", temp);
+    for (uint8_t i = 0; i < 8; i++)
+        snprintf(rom_id + 2 * i, 3, "%02x", rom[idx][i]);
+    p.tag("rom_id", rom_id);
+
+    if (count >= 1)
+        p.field("temperature", values[0]);
 }
 
-Sensor_DS18B20::Sensor_DS18B20(const JsonVariant &j) :
-    temp(21.), ds(nullptr), mem(-1)
+Sensor_DS18B20::Sensor_DS18B20(const JsonVariant &j, BusManager *buses) :
+    num_probes(0), bus(nullptr), ds(nullptr), rom_cache(nullptr),
+    rom_cache_size(0), resolution(0)
 {
     uint8_t pin;
-    int rtcmem;
 
     Serial.println(F("Initializing DS18B20"));
 
     initialized = false;
     pin = j["pin"] | 12;
 
-    threshold_temp = j["threshold_temp"] | 0.1;
+    /* the probes resolve 1/16 °C at most */
+    change.add_field(j, "temperature", j["threshold_temp"] | 0.1, 0.0625);
 
     tags = j["tags"] | "";
 
-    rtcmem = j["rtcmem_slot"] | -1;
-    mem = RTCMEM_SENSOR(rtcmem);
+    rom_cache_instance = rtcmem.new_instance(RTCMEM_TAG_DS18B20_ROMS);
+    rom_cache = (ds18b20_rom_cache *)rtcmem.find(RTCMEM_TAG_DS18B20_ROMS,
+                                                 rom_cache_instance,
+                                                 rom_cache_size);
+    rescan_after = j["rescan_after"] | 100;
+    resolution = j["resolution"] | 0;
+    if (resolution && (resolution < 9 || resolution > 12)) {
+        Serial.printf("  DS18B20 invalid resolution %u\n", resolution);
+        resolution = 0;
+    }
+
+    if (!load_rom_cache(buses, pin))
+        scan(buses, pin);
 
-    ds = new DS18B20(pin);
-    if (!ds->selectNext())
+    if (!num_probes)
         return;
 
     initialized = true;
@@ -5,118 +5,182 @@
  *
  */
 
-#include <SoftwareSerial.h>
 #include <sml_parser.h>
 #include <constants.h>
+#include <sml_stream.h>
 
 #include "sensors/sml.h"
 
-static std::string obis_energy_total_positive("1-0:1.8.0");
-static std::string obis_energy_total_negative("1-0:2.8.0");
-static std::string obis_power_current("1-0:16.7.0");
-const char START_BYTES_DETECTED = 1;
-const char END_BYTES_DETECTED = 2;
-
-uint8_t get_code(uint8_t byte) {
-	switch (byte) {
-	case 0x1b:
-		return 1;
-	case 0x01:
-		return 2;
-	case 0x1a:
-		return 3;
-	default:
-		return 0;
-	}
-}
+/* used if the config has no "obis" list */
+static const struct {
+	const char *code;
+	const char *field;
+	float factor;
+} obis_default[] = {
+	{ "1-0:1.8.0",  "en_tot_pos", 0.001 },	/* Wh -> kWh */
+	{ "1-0:2.8.0",  "en_tot_neg", 0.001 },	/* Wh -> kWh */
+	{ "1-0:16.7.0", "pow_cur",    1.0 },
+};
 
-bool Sensor_SML::sample_process() {
-	bool done;
+static uint64_t obis_key(const uint8_t *code, uint8_t len) {
+	uint64_t key = 0;
 
-	done = false;
+	for (uint8_t i = 0; i < esphome::sml::SML_OBIS_CODE_LENGTH; i++)
+		key = (key << 8) | (i < len ? code[i] : 0);
 
-	Serial.printf("sml: started processing message\n");
+	return key;
+}
 
-	esphome::sml::SmlFile sml_file = esphome::sml::SmlFile(sml_message);
-	std::vector<esphome::sml::ObisInfo> obis_info_vec =
-		sml_file.get_obis_info();
-	for (auto const &obis_info : obis_info_vec) {
-		Serial.printf("OBIS-code: %s\n", obis_info.code_repr().c_str());
-		if(obis_info.code_repr() == obis_energy_total_positive) {
-			energy_total_positive =
-				(float)((double)esphome::sml::bytes_to_uint(obis_info.value) / 10000.0);
-			done = true;
-			Serial.printf("sml: positive active energy, total: %4.2f kWh\n", energy_total_positive);
-		}
-		if(obis_info.code_repr() == obis_energy_total_negative) {
-			energy_total_negative =
-				(float)((double)esphome::sml::bytes_to_uint(obis_info.value) / 10000.0);
-			done = true;
-			Serial.printf("sml: negative active energy, total: %4.2f kWh\n", energy_total_negative);
-		}
-		if(obis_info.code_repr() == obis_power_current) {
-			power_current =
-				(float)((double)esphome::sml::bytes_to_uint(obis_info.value) / 1.0);
-			done = true;
-			Serial.printf("sml: absolute active instantaneous power: %4.2f W\n", power_current);
-		}
+/*
+ * "A-B:C.D.E" with an optional "*F", returns the number of groups or 0. The
+ * hh length modifier of sscanf is not supported everywhere, without it the
+ * conversions would write full ints into the bytes of c.
+ */
+static uint8_t parse_obis(const char *s, uint8_t *c) {
+	static const char sep[] = "-:..*";
+	unsigned long v;
+	char *end;
+	uint8_t n = 0;
+
+	for (;;) {
+		if (!isdigit((unsigned char)*s))
+			return 0;
+		v = strtoul(s, &end, 10);
+		if (v > UINT8_MAX)
+			return 0;
+		c[n++] = v;
+		if (!*end)
+			return n >= 5 ? n : 0;
+		if (*end != sep[n - 1])
+			return 0;
+		s = end + 1;
 	}
-
-	return done;
 }
 
-uint16_t calc_crc16_p1021(esphome::sml::bytes::const_iterator begin,
-			  esphome::sml::bytes::const_iterator end,
-			  uint16_t crcsum) {
-	for (auto it = begin; it != end; it++) {
-		crcsum = (crcsum >> 8) ^
-			esphome::sml::CRC16_X25_TABLE[(crcsum & 0xff) ^ *it];
+bool Sensor_SML::add_obis(const JsonVariant &j, const char *code,
+			  const char *field, float factor, float threshold) {
+	uint8_t c[esphome::sml::SML_OBIS_CODE_LENGTH] = {0};
+	sml_obis *o;
+	uint8_t n;
+
+	if (num_obis >= SML_MAX_OBIS) {
+		Serial.printf("sml: too many OBIS codes, ignoring %s\n", code);
+		return false;
 	}
-	return crcsum;
-}
 
-uint16_t calc_crc16_x25(esphome::sml::bytes::const_iterator begin,
-			esphome::sml::bytes::const_iterator end,
-			uint16_t crcsum = 0) {
-	crcsum = calc_crc16_p1021(begin, end, crcsum ^ 0xffff) ^ 0xffff;
-	return (crcsum >> 8) | ((crcsum & 0xff) << 8);
-}
+	n = parse_obis(code, c);
+	if (!n || !field) {
+		Serial.printf("sml: invalid OBIS code %s\n", code);
+		return false;
+	}
 
-uint16_t calc_crc16_kermit(esphome::sml::bytes::const_iterator begin,
-			   esphome::sml::bytes::const_iterator end,
-			   uint16_t crcsum = 0) {
-	return calc_crc16_p1021(begin, end, crcsum);
+	/* D group 8 are meter readings (energy), everything else is treated
+	 * like an instantaneous value (power)
+	 */
+	if (threshold < 0)
+		threshold = c[3] == 8 ? threshold_energy : threshold_power;
+	if (!change.add_field(j, field, threshold, c[3] == 8 ? 0.001 : 0.1))
+		return false;
+
+	o = &obis[num_obis++];
+	o->key = obis_key(c, sizeof(c));
+	o->mask = n == 6 ? 0xffffffffffffULL : 0xffffffffff00ULL;
+	o->field = field;
+	o->factor = factor;
+	o->value = NAN;
+
+	return true;
 }
 
-bool Sensor_SML::checksum_check() {
-	uint16_t crc_received;
+static float obis_scale(int64_t value, int8_t scaler) {
+	double v = value;
+
+	for (; scaler > 0; scaler--)
+		v *= 10;
+	for (; scaler < 0; scaler++)
+		v /= 10;
 
-	crc_received = (sml_message.at(sml_message.size() - 2) << 8) |
-		sml_message.at(sml_message.size() - 1);
-	if (crc_received == calc_crc16_x25(sml_message.begin(),
-					   sml_message.end() - 2, 0x6e23)) {
-		return true;
+	return v;
+}
+
+void Sensor_SML::process_entry(const esphome::sml::SmlObisEntry &entry) {
+	uint64_t key;
+	int64_t value;
+
+	key = obis_key(entry.code, entry.code_length);
+	for (uint8_t i = 0; i < num_obis; i++) {
+		if ((key & obis[i].mask) != obis[i].key)
+			continue;
+
+		if (entry.value_type == esphome::sml::SML_INT)
+			value = esphome::sml::bytes_to_int(entry.value,
+							   entry.value_length);
+		else
+			value = esphome::sml::bytes_to_uint(entry.value,
+							    entry.value_length);
+		pending[i] = obis_scale(value, entry.scaler) * obis[i].factor;
+		obis_seen |= 1 << i;
+		Serial.printf("sml: %s = %4.2f (unit %u)\n",
+			      obis[i].field.c_str(), pending[i],
+			      (uint8_t)entry.unit);
+		break;
 	}
+}
 
-	if (crc_received == calc_crc16_kermit(sml_message.begin(),
-					      sml_message.end() - 2, 0xed50)) {
-		return true;
+/*
+ * Feed everything the meter sent so far into the stream decoder. Returns true
+ * once a complete telegram with a valid checksum arrived. The CRC is updated
+ * by the decoder as the bytes come in, so it is known as soon as the trailer
+ * has been received. Values are only provisional until then and are thrown
+ * away with the telegram if the CRC does not match.
+ */
+bool Sensor_SML::receive() {
+	uint8_t buf[64];
+	size_t len;
+
+	while ((len = port->read(buf, sizeof(buf))) > 0) {
+		counters.bytes_read += len;
+		for (size_t i = 0; i < len; i++) {
+			switch (decoder.push(buf[i])) {
+			case esphome::sml::SML_STREAM_START:
+				obis_seen = 0;
+				break;
+			case esphome::sml::SML_STREAM_ENTRY:
+				process_entry(decoder.entry());
+				break;
+			case esphome::sml::SML_STREAM_END:
+				Serial.printf("sml: end detected\n");
+				if (decoder.crc_result() ==
+				    esphome::sml::CHECK_CRC16_FAILED) {
+					Serial.printf("sml: checksum incorrect\n");
+					counters.checksum_errors++;
+					obis_seen = 0;
+					break;
+				}
+				if (obis_seen)
+					return true;
+				break;
+			case esphome::sml::SML_STREAM_ERROR:
+				Serial.printf("sml: malformed telegram\n");
+				counters.resyncs++;
+				obis_seen = 0;
+				break;
+			default:
+				break;
+			}
+		}
 	}
 
 	return false;
 }
 
-char Sensor_SML::check_start_end_bytes(uint8_t byte) {
-  incoming_mask = (incoming_mask << 2) | get_code(byte);
-
-  if (incoming_mask == esphome::sml::START_MASK)
-    return START_BYTES_DETECTED;
-  if ((incoming_mask >> 6) == esphome::sml::END_MASK)
-    return END_BYTES_DETECTED;
-  return 0;
+uint32_t Sensor_SML::ready_at() {
+	return next_poll;
 }
 
 Sensor_State Sensor_SML::sample() {
+	bool ok;
+
 	if (state != SENSOR_NOT_INIT && state != SENSOR_INIT)
 		return state;
 	state = SENSOR_INIT;
@@ -126,112 +190,51 @@ Sensor_State Sensor_SML::sample() {
 		return SENSOR_NOT_INIT;
 	}
 
-	if (data_upload)
-		return SENSOR_DONE_UPDATE;
-
-	if (!sensor_serial->available()) {
+	ok = receive();
+	counters.bus_errors = min(port->get_overruns(), (uint32_t)UINT8_MAX);
+	if (!ok) {
+		/* with all values in, only the rest of the telegram and its
+		 * CRC are missing, there is no point in waiting a full poll
+		 */
+		if (fast_poll && num_obis &&
+		    obis_seen == (1 << num_obis) - 1)
+			next_poll = millis() + SML_TRAILER_POLL_MS;
+		else
+			next_poll = millis() + UART_POLL_MS;
 		return state;
 	}
 
-	while (sensor_serial->available()) {
-		const char c = sensor_serial->read();
-
-		delay(1);
-		if (record)
-			sml_message.emplace_back(c);
-
-		switch (check_start_end_bytes(c)) {
-		case START_BYTES_DETECTED: {
-			Serial.printf("sml: start detected\n");
-			record = true;
-			sml_message.clear();
-			break;
-		};
-		case END_BYTES_DETECTED: {
-			if (record) {
-				record = false;
-				finished = true;
-				Serial.printf("sml: end detected\n");
-			}
-			break;
-		};
-		};
+	for (uint8_t i = 0; i < num_obis; i++) {
+		if (obis_seen & (1 << i))
+			obis[i].value = pending[i];
 	}
+	measured = true;
 
-	if (finished == false)
-		return state;
-	finished = false;
-
-	Serial.printf("sml: checking checksum\n");
-	if (!checksum_check()) {
-		Serial.printf("sml: checksum incorrect\n");
-		sml_message.clear();
-		return state;
-	}
-
-	sml_message.resize(sml_message.size() - 8);
-
-	// Now a complete SML message is captured
-	// Lets do the evaluation stuff
-	if (!sample_process()) {
-		return state;
-	}
-
-	if (mem < 0) {
-		state = SENSOR_DONE_UPDATE;
-		return state;
-	}
-
-	state = SENSOR_DONE_NOUPDATE;
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
+	state = SENSOR_DONE;
+	return state;
+}
 
-	if (threshold_helper_float(energy_total_positive,
-				   rtc_data.energy_total_positive,
-				   threshold_energy)) {
-		state = SENSOR_DONE_UPDATE;
-		rtc_data.energy_total_positive = energy_total_positive;
-	}
-	if (threshold_helper_float(energy_total_negative,
-				   rtc_data.energy_total_negative,
-				   threshold_energy)) {
-		state = SENSOR_DONE_UPDATE;
-		rtc_data.energy_total_negative = energy_total_negative;
-	}
-	if (threshold_helper_float(power_current,
-				   rtc_data.power_current,
-				   threshold_power)) {
-		state = SENSOR_DONE_UPDATE;
-		rtc_data.power_current = power_current;
-	}
+static_assert(SML_MAX_OBIS <= SAMPLE_BUFFER_MAX_VALUES,
+	      "SML values do not fit into a sample");
 
-	if (state == SENSOR_DONE_UPDATE) {
-		rtc_data.data_upload = 0xdeadbeef;
-	} else {
-		rtc_data.data_upload = 0;
-	}
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
+uint8_t Sensor_SML::get_values(uint8_t, float *values) {
+	if (!measured)
+		return 0;
 
-	return state;
+	for (uint8_t i = 0; i < num_obis; i++)
+		values[i] = obis[i].value;
+	return num_obis;
 }
 
-void Sensor_SML::publish(Point &p) {
-	if (!initialized)
-		return;
-
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	rtc_data.data_upload = 0;
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	p.addField("en_tot_pos", rtc_data.energy_total_positive);
-	p.addField("en_tot_neg", rtc_data.energy_total_negative);
-	p.addField("pow_cur", rtc_data.power_current);
+void Sensor_SML::publish_values(LineProtocol &p, uint8_t,
+				const float *values, uint8_t count) {
+	for (uint8_t i = 0; i < num_obis && i < count; i++)
+		p.field(obis[i].field.c_str(), values[i]);
 }
 
 Sensor_SML::Sensor_SML(const JsonVariant &j) :
-	energy_total_positive(-1), energy_total_negative(-1),
-	power_current(-1), mem(-1), data_upload(false)
+	num_obis(0), port(nullptr), fast_poll(false)
 {
-	int rtcmem;
-
 	Serial.println(F("Initializing SML "));
 
 	initialized = false;
@@ -242,23 +245,24 @@ Sensor_SML::Sensor_SML(const JsonVariant &j) :
 	threshold_energy = j["threshold_energy"] | 1;
 	threshold_power = j["threshold_power"] | 50.0;
 
-	rtcmem = j["rtcmem_slot"] | -1;
-	mem = RTCMEM_SENSOR(rtcmem);
+	fast_poll = j["fast_poll"] | false;
+
+	if (j["obis"].isNull()) {
+		for (auto const &o : obis_default)
+			add_obis(j, o.code, o.field, o.factor, -1);
+	} else {
+		for (JsonVariant o : j["obis"].as<JsonArray>())
+			add_obis(j, o["code"] | "",
+				 o["field"].as<const char *>(),
+				 o["factor"] | 1.0,
+				 o["threshold"] | -1.0);
+	}
 
 	tags = j["tags"] | "";
 
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	if (rtc_data.data_upload == 0xdeadbeef) {
-		rtc_data.data_upload = 0;
-		ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data,
-				       sizeof(rtc_data));
-		data_upload = true;
-		initialized = true;
+	port = uart_open(rx, tx, 9600, j["hw_uart"] | false);
+	if (!port)
 		return;
-	}
-
-	sensor_serial = std::make_shared<SoftwareSerial>(rx, tx);
-	sensor_serial->begin(9600);
 
 	initialized = true;
 }
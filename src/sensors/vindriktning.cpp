@@ -6,14 +6,9 @@
  *
  */
 
-#include <SoftwareSerial.h>
-
 #include "sensors/vindriktning.h"
-const char START_BYTES_DETECTED = 1;
-const char END_BYTES_DETECTED = 2;
-const uint32_t START_MASK = 0x0016110B;
 
-bool Sensor_VINDRIKTNING::sample_process() {
+bool Sensor_VINDRIKTNING::sample_process(const uint8_t *frame) {
 	/**
 	 *         MSB  DF 3     DF 4  LSB
 	 * uint16_t = xxxxxxxx xxxxxxxx
@@ -22,7 +17,7 @@ bool Sensor_VINDRIKTNING::sample_process() {
 	uint16_t pm25_cur;
 	float pm25_calc;
 
-	pm25_cur = (vind_message[5] << 8) | vind_message[6];
+	pm25_cur = (frame[5] << 8) | frame[6];
 	pm25_meas[pm25_meas_idx] = pm25_cur;
 	pm25_meas_idx = (pm25_meas_idx + 1) % 5;
 
@@ -35,28 +30,43 @@ bool Sensor_VINDRIKTNING::sample_process() {
 		done = true;
 	}
 
-	vind_message.clear();
 	return done;
 }
 
-char Sensor_VINDRIKTNING::check_start_end_bytes(uint8_t byte) {
-  incoming_mask = (incoming_mask << 8) | byte;
-
-  if ((incoming_mask & START_MASK) == START_MASK)
-    return START_BYTES_DETECTED;
-  if (record && vind_message.size() > 19)
-    return END_BYTES_DETECTED;
-  return 0;
-}
+/*
+ * Drain the UART and run every byte through the frame decoder. Returns true
+ * once enough frames for an averaged reading have been received.
+ */
+bool Sensor_VINDRIKTNING::receive() {
+	uint8_t buf[32];
+	size_t len;
 
-bool Sensor_VINDRIKTNING::checksum_valid() {
-	uint8_t checksum = 0;
+	bool done = false;
 
-	for (uint8_t i = 0; i < 20; i++) {
-		checksum += vind_message[i];
+	while (!done && (len = port->read(buf, sizeof(buf))) > 0) {
+		counters.bytes_read += len;
+		for (size_t i = 0; i < len && !done; i++) {
+			switch (decoder.push(buf[i])) {
+			case FRAME_DONE:
+				done = sample_process(decoder.data());
+				break;
+			case FRAME_BAD_CHECKSUM:
+				Serial.printf("vindriktning: checksum incorrect\n");
+				counters.checksum_errors++;
+				break;
+			default:
+				break;
+			}
+		}
 	}
+	counters.resyncs = decoder.get_resyncs();
+	counters.bus_errors = min(port->get_overruns(), (uint32_t)UINT8_MAX);
 
-	return checksum == 0;
+	return done;
+}
+
+uint32_t Sensor_VINDRIKTNING::ready_at() {
+	return next_poll;
 }
 
 Sensor_State Sensor_VINDRIKTNING::sample() {
@@ -69,92 +79,33 @@ Sensor_State Sensor_VINDRIKTNING::sample() {
 		return SENSOR_NOT_INIT;
 	}
 
-	if (data_upload)
-		return SENSOR_DONE_UPDATE;
-
-	if (!sensor_serial->available()) {
-		return state;
-	}
-
-	while (sensor_serial->available()) {
-		const char c = sensor_serial->read();
-
-		delay(1);
-		if (record)
-			vind_message.emplace_back(c);
-
-		switch (check_start_end_bytes(c)) {
-		case START_BYTES_DETECTED: {
-			Serial.printf("vindriktning: start detected\n");
-			record = true;
-			vind_message.clear();
-			vind_message.emplace_back(0x16);
-			vind_message.emplace_back(0x11);
-			vind_message.emplace_back(0x0B);
-			break;
-		};
-		case END_BYTES_DETECTED: {
-			if (record) {
-				record = false;
-				finished = true;
-				Serial.printf("vindriktning: end detected\n");
-			}
-			break;
-		};
-		};
-	}
-
-	if (finished == false)
-		return state;
-	finished = false;
-
-	Serial.printf("vindriktning: checking checksum\n");
-	if (!checksum_valid()) {
-		Serial.printf("vindriktning: checksum incorrect\n");
-		vind_message.clear();
-		return state;
-	}
-
-	if (!sample_process()) {
-		return state;
-	}
-
-	if (mem < 0) {
-		state = SENSOR_DONE_UPDATE;
+	if (!receive()) {
+		next_poll = millis() + UART_POLL_MS;
 		return state;
 	}
+	measured = true;
 
-	state = SENSOR_DONE_NOUPDATE;
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	if (threshold_helper_float(pm25, rtc_data.pm25, threshold_pm25)) {
-		state = SENSOR_DONE_UPDATE;
-		rtc_data.pm25 = pm25;
-	}
-	if (state == SENSOR_DONE_UPDATE) {
-		rtc_data.data_upload = 0xdeadbeef;
-	} else {
-		rtc_data.data_upload = 0;
-	}
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-
+	state = SENSOR_DONE;
 	return state;
 }
 
-void Sensor_VINDRIKTNING::publish(Point &p) {
-	if (!initialized)
-		return;
+uint8_t Sensor_VINDRIKTNING::get_values(uint8_t, float *values) {
+	if (!measured)
+		return 0;
+
+	values[0] = pm25;
+	return 1;
+}
 
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	rtc_data.data_upload = 0;
-	ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	p.addField("pm2.5", rtc_data.pm25);
+void Sensor_VINDRIKTNING::publish_values(LineProtocol &p, uint8_t,
+					 const float *values, uint8_t count) {
+	if (count >= 1)
+		p.field("pm2.5", values[0]);
 }
 
 Sensor_VINDRIKTNING::Sensor_VINDRIKTNING(const JsonVariant &j) :
-	pm25(-1), mem(-1), data_upload(false)
+	pm25(-1), port(nullptr)
 {
-	int rtcmem;
-
 	Serial.println(F("Initializing VINDRIKTNING "));
 
 	initialized = false;
@@ -162,26 +113,15 @@ Sensor_VINDRIKTNING::Sensor_VINDRIKTNING(const JsonVariant &j) :
 	rx = j["rx"] | 4;
 	tx = j["tx"] | 5;
 
-	threshold_pm25 = j["threshold_pm25"] | 5.0;
-
-	rtcmem = j["rtcmem_slot"] | -1;
-	mem = RTCMEM_SENSOR(rtcmem);
+	change.add_field(j, "pm2.5", j["threshold_pm25"] | 5.0, 0.1);
 
 	tags = j["tags"] | "";
 
-	ESP.rtcUserMemoryRead(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-	if (rtc_data.data_upload == 0xdeadbeef) {
-		rtc_data.data_upload = 0;
-		ESP.rtcUserMemoryWrite(mem, (uint32_t *)&rtc_data, sizeof(rtc_data));
-		data_upload = true;
-		initialized = true;
-		return;
-	}
-
 	pm25_meas_idx = 0;
 
-	sensor_serial = std::make_shared<SoftwareSerial>(rx, tx);
-	sensor_serial->begin(9600);
+	port = uart_open(rx, tx, 9600, j["hw_uart"] | false);
+	if (!port)
+		return;
 
 	initialized = true;
 }
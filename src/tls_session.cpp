@@ -0,0 +1,84 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <coredecls.h>
+#include <time.h>
+
+#include "rtcmem.h"
+#include "tls_session.h"
+
+static_assert(RTCMEM_RECORD_WORDS(sizeof(struct tls_session_entry)) <=
+              RTCMEM_BUDGET_TLS_SESSIONS, "TLS session over RTC budget");
+
+void TlsSessionCache::begin() {
+    entry = (struct tls_session_entry *)rtcmem.get(RTCMEM_TAG_TLS_SESSIONS,
+                                                   sizeof(*entry));
+    if (!entry)
+        Serial.println(F("No RTC memory for the TLS session"));
+}
+
+static uint32_t host_hash(const char *host) {
+    return crc32(host, strlen(host));
+}
+
+/* the entry if it holds a session of host which did not expire */
+struct tls_session_entry *TlsSessionCache::find(uint32_t host) {
+    uint32_t now = time(nullptr);
+
+    if (!entry)
+        return nullptr;
+
+    if (entry->expires && (int32_t)(entry->expires - now) < 0)
+        entry->expires = 0;
+    if (!entry->expires || entry->host != host)
+        return nullptr;
+
+    return entry;
+}
+
+bool TlsSessionCache::offer(const char *host, BearSSL::Session &session,
+                            bool &mfln) {
+    struct tls_session_entry *e = find(host_hash(host));
+
+    offered_len = 0;
+    if (!e || !e->params.session_id_len)
+        return false;
+
+    memcpy(session.getSession(), &e->params, sizeof(e->params));
+    offered_len = e->params.session_id_len;
+    memcpy(offered_id, e->params.session_id, offered_len);
+    mfln = e->mfln;
+
+    return true;
+}
+
+void TlsSessionCache::update(const char *host, BearSSL::Session &session,
+                             bool mfln) {
+    const br_ssl_session_parameters *p = session.getSession();
+
+    /* a resumed session keeps its id and its expiry */
+    if (offered_len && p->session_id_len == offered_len &&
+        !memcmp(p->session_id, offered_id, offered_len)) {
+        offered_len = 0;
+        hits++;
+        return;
+    }
+    offered_len = 0;
+    misses++;
+
+    if (!entry)
+        return;
+
+    entry->expires = 0;
+    if (!p->session_id_len)
+        return;
+
+    entry->host = host_hash(host);
+    entry->expires = time(nullptr) + TLS_SESSION_MAX_AGE_S;
+    entry->mfln = mfln;
+    memcpy(&entry->params, p, sizeof(entry->params));
+}
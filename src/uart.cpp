@@ -0,0 +1,123 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+
+#include "sensor_drivers.h"
+#include "uart.h"
+
+/* the SoftwareSerial instances below would be kept for their constructors */
+#if defined(SENSOR_SML) || defined(SENSOR_VINDRIKTNING)
+
+static UartPort ports[UART_MAX_PORTS];
+static SoftwareSerial sw_serial[UART_MAX_PORTS];
+static uint8_t num_ports;
+/* console baud rate while UART0 is swapped over to a sensor, 0 otherwise */
+static uint32_t console_baud;
+
+void UartPort::check_overrun() {
+    bool overrun;
+
+    if (hw)
+        overrun = Serial.hasOverrun();
+    else
+        overrun = static_cast<SoftwareSerial *>(stream)->overflow();
+
+    if (overrun) {
+        overruns++;
+        Serial.printf("uart: rx %d overrun\n", rx);
+    }
+}
+
+size_t UartPort::read(uint8_t *buf, size_t len) {
+    size_t n = 0;
+
+    if (!stream)
+        return 0;
+
+    while (n < len && stream->available() > 0)
+        buf[n++] = stream->read();
+
+    bytes_read += n;
+    check_overrun();
+
+    return n;
+}
+
+UartPort *uart_open(int8_t rx, int8_t tx, uint32_t baud, bool hw) {
+    UartPort *port;
+
+    /* two sensors on one pin would steal each other's bytes */
+    for (uint8_t i = 0; i < num_ports; i++) {
+        if (ports[i].rx == rx) {
+            Serial.printf("uart: rx %d is already in use\n", rx);
+            return nullptr;
+        }
+    }
+
+    if (num_ports >= UART_MAX_PORTS) {
+        Serial.printf("uart: no port left for rx %d\n", rx);
+        return nullptr;
+    }
+
+    if (hw && (rx != UART_HW_RX_PIN || tx != UART_HW_TX_PIN)) {
+        Serial.printf("uart: UART0 needs rx %d tx %d, using SoftwareSerial\n",
+                      UART_HW_RX_PIN, UART_HW_TX_PIN);
+        hw = false;
+    }
+
+    port = &ports[num_ports];
+    port->rx = rx;
+    port->tx = tx;
+    port->baud = baud;
+    port->hw = hw;
+
+    if (hw) {
+        Serial.printf("uart: switching UART0 to GPIO%d/GPIO%d @ %u, "
+                      "console muted until sampling is done\n",
+                      rx, tx, baud);
+        Serial.flush();
+        console_baud = Serial.baudRate();
+        Serial.end();
+        Serial.setRxBufferSize(UART_RX_BUFFER_SIZE);
+        /* without TX, console output is dropped instead of being sent
+         * to the sensor at its baud rate
+         */
+        Serial.begin(baud, SERIAL_8N1, SERIAL_RX_ONLY);
+        Serial.swap();
+        port->stream = &Serial;
+    } else {
+        SoftwareSerial *sw = &sw_serial[num_ports];
+        sw->begin(baud, SWSERIAL_8N1, rx, tx, false, UART_RX_BUFFER_SIZE);
+        port->stream = sw;
+    }
+
+    num_ports++;
+    return port;
+}
+
+void uart_release() {
+    if (!console_baud)
+        return;
+
+    for (uint8_t i = 0; i < num_ports; i++) {
+        if (ports[i].hw)
+            ports[i].stream = nullptr;
+    }
+
+    /* begin() puts UART0 back onto GPIO1/GPIO3 */
+    Serial.end();
+    Serial.begin(console_baud);
+    console_baud = 0;
+    Serial.println(F("uart: console back on UART0"));
+}
+
+#else
+
+void uart_release() {}
+
+#endif
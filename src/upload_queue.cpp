@@ -0,0 +1,130 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <FS.h>
+#include <LittleFS.h>
+
+#include "upload_queue.h"
+
+size_t upload_chunk_len(const char *s, size_t len, size_t max) {
+    size_t n;
+
+    if (len <= max)
+        return len;
+
+    for (n = max; n > 0; n--) {
+        if (s[n - 1] == '\n')
+            return n;
+    }
+
+    /* a single line longer than max goes out on its own */
+    for (n = max; n < len; n++) {
+        if (s[n] == '\n')
+            return n + 1;
+    }
+
+    return len;
+}
+
+String UploadQueue::segment_name(uint32_t n) {
+    char name[sizeof(UPLOAD_QUEUE_DIR) + 10];
+
+    snprintf(name, sizeof(name), UPLOAD_QUEUE_DIR "/%08x", n);
+    return String(name);
+}
+
+/* segments are numbered, the directory holds a contiguous range of them */
+void UploadQueue::scan() {
+    Dir dir;
+    uint32_t n;
+    bool found = false;
+
+    if (scanned)
+        return;
+    scanned = true;
+
+    dir = LittleFS.openDir(UPLOAD_QUEUE_DIR);
+    while (dir.next()) {
+        n = strtoul(dir.fileName().c_str(), nullptr, 16);
+        if (!found || n < first)
+            first = n;
+        if (!found || n >= next)
+            next = n + 1;
+        found = true;
+    }
+}
+
+bool UploadQueue::empty() {
+    scan();
+    return first == next;
+}
+
+void UploadQueue::add(const char *lines, size_t len) {
+    size_t n, size = 0;
+    File f;
+
+    scan();
+    if (next != first) {
+        f = LittleFS.open(segment_name(next - 1), "r");
+        if (f)
+            size = f.size();
+        f.close();
+    }
+
+    while (len) {
+        n = upload_chunk_len(lines, len, UPLOAD_QUEUE_SEGMENT_SIZE - size);
+        if (!size || n > UPLOAD_QUEUE_SEGMENT_SIZE - size) {
+            /* does not fit, start a new segment */
+            if (next - first >= UPLOAD_QUEUE_MAX_SEGMENTS) {
+                Serial.println(F("upload queue full, dropping oldest"));
+                drop_oldest();
+            }
+            next++;
+            size = 0;
+            n = upload_chunk_len(lines, len, UPLOAD_QUEUE_SEGMENT_SIZE);
+        }
+
+        f = LittleFS.open(segment_name(next - 1), "a");
+        if (!f) {
+            Serial.println(F("upload queue not writable"));
+            return;
+        }
+        f.write((const uint8_t *)lines, n);
+        f.close();
+
+        size += n;
+        lines += n;
+        len -= n;
+    }
+}
+
+bool UploadQueue::oldest(String &lines) {
+    File f;
+
+    scan();
+    while (first != next) {
+        f = LittleFS.open(segment_name(first), "r");
+        if (f) {
+            lines = f.readString();
+            f.close();
+            if (lines.length())
+                return true;
+        }
+        drop_oldest();
+    }
+
+    return false;
+}
+
+void UploadQueue::drop_oldest() {
+    scan();
+    if (first == next)
+        return;
+
+    LittleFS.remove(segment_name(first));
+    first++;
+}
@@ -0,0 +1,48 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _NATIVE_ARDUINO_H_
+#define _NATIVE_ARDUINO_H_
+
+/*
+ * Just enough of the Arduino core to build hardware independent modules on
+ * the host for the native test environment.
+ */
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+using std::max;
+using std::min;
+
+#define F(s) (s)
+
+/* set by the tests */
+extern uint32_t native_millis;
+
+static inline uint32_t millis() { return native_millis; }
+
+static inline char *dtostrf(double v, signed char width, unsigned char prec,
+                            char *s) {
+    sprintf(s, "%*.*f", width, prec, v);
+    return s;
+}
+
+class NativeSerial {
+public:
+    template <typename... Args>
+    int printf(const char *fmt, Args... args) { return ::printf(fmt, args...); }
+    int print(const char *s) { return ::printf("%s", s); }
+    int println(const char *s) { return ::printf("%s\n", s); }
+};
+
+extern NativeSerial Serial;
+
+#endif
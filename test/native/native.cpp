@@ -0,0 +1,23 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+
+#include "rtcmem.h"
+
+uint32_t native_millis;
+NativeSerial Serial;
+
+RtcMem rtcmem;
+
+/*
+ * Every record is the whole image, which is enough for tests of a single RTC
+ * memory user. The image survives like the RTC memory does across a wake,
+ * get(tag, 0) hands it to tests which want to look at it or break it.
+ */
+void *RtcMem::get(uint8_t, size_t size, uint8_t) {
+    return size <= sizeof(image) ? image : nullptr;
+}
@@ -0,0 +1,176 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+#include <vector>
+
+#include "frame_decoder.h"
+
+/*
+ * Host benchmark of the VINDRIKTNING framing, FrameDecoder against the
+ * decoder it replaced. Times are printed only, the frame counts are checked.
+ */
+
+#define FRAMES  50000
+#define NOISE   7       /* bytes of line noise between frames */
+
+typedef FrameDecoder<SyncBytes<0x16, 0x11, 0x0b>, FixedLength<20>, Sum8, 20>
+    VindriktningFrame;
+typedef FrameDecoder<SyncBytes<0x42, 0x4d>, LengthField<2, 4>, Sum16BE, 32>
+    PmsFrame;
+
+/* the sensor driver before FrameDecoder, without the serial port */
+class OldDecoder {
+private:
+    std::vector<uint8_t> message;
+    uint32_t incoming_mask = 0;
+    bool record = false;
+
+public:
+    bool push(uint8_t c) {
+        uint8_t sum = 0;
+
+        if (record)
+            message.emplace_back(c);
+        incoming_mask = (incoming_mask << 8) | c;
+        if ((incoming_mask & 0x0016110b) == 0x0016110b) {
+            record = true;
+            message.clear();
+            message.emplace_back(0x16);
+            message.emplace_back(0x11);
+            message.emplace_back(0x0b);
+            return false;
+        }
+        if (!record || message.size() <= 19)
+            return false;
+
+        record = false;
+        for (uint8_t i = 0; i < 20; i++)
+            sum += message[i];
+        message.clear();
+        return sum == 0;
+    }
+};
+
+static std::vector<uint8_t> stream;
+
+static void vindriktning_frame(uint8_t *frame, uint16_t pm25) {
+    uint8_t sum = 0;
+
+    memset(frame, 0, 20);
+    frame[0] = 0x16;
+    frame[1] = 0x11;
+    frame[2] = 0x0b;
+    frame[5] = pm25 >> 8;
+    frame[6] = pm25;
+    for (uint8_t i = 7; i < 19; i++)
+        frame[i] = rand() % 0x10;
+    for (uint8_t i = 0; i < 19; i++)
+        sum += frame[i];
+    frame[19] = -sum;
+}
+
+template <typename D, typename F>
+static double ns_per_byte(const char *name, D &decoder, F done, long &n) {
+    char msg[64];
+    double ns;
+
+    n = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t c : stream)
+        n += done(decoder.push(c));
+    auto end = std::chrono::steady_clock::now();
+
+    ns = std::chrono::duration<double, std::nano>(end - start).count() /
+        stream.size();
+    snprintf(msg, sizeof(msg), "%s: %.2f ns/byte, %ld frames", name, ns, n);
+    TEST_MESSAGE(msg);
+
+    return ns;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_bench() {
+    VindriktningFrame frame_decoder;
+    OldDecoder old_decoder;
+    long n_new, n_old;
+
+    ns_per_byte("FrameDecoder", frame_decoder,
+                [](FrameResult r) { return r == FRAME_DONE; }, n_new);
+    ns_per_byte("old decoder", old_decoder, [](bool r) { return r; }, n_old);
+    TEST_ASSERT_EQUAL(FRAMES, n_new);
+    TEST_ASSERT_EQUAL(FRAMES, n_old);
+}
+
+static void test_vindriktning() {
+    VindriktningFrame decoder;
+    uint8_t frame[20];
+    FrameResult r = FRAME_NONE;
+
+    vindriktning_frame(frame, 1234);
+    /* a partial sync sequence first */
+    decoder.push(0x16);
+    decoder.push(0x11);
+    for (uint8_t c : frame)
+        r = decoder.push(c);
+    TEST_ASSERT_EQUAL(FRAME_DONE, r);
+    TEST_ASSERT_EQUAL(20, decoder.size());
+    TEST_ASSERT_EQUAL(1234, decoder.data()[5] << 8 | decoder.data()[6]);
+    TEST_ASSERT_EQUAL(1, decoder.get_resyncs());
+
+    frame[10] ^= 1;
+    for (uint8_t c : frame)
+        r = decoder.push(c);
+    TEST_ASSERT_EQUAL(FRAME_BAD_CHECKSUM, r);
+}
+
+static void test_length_field() {
+    PmsFrame decoder;
+    uint8_t frame[32] = {0x42, 0x4d, 0, 28};
+    FrameResult r = FRAME_NONE;
+    uint16_t sum = 0;
+
+    for (uint8_t i = 4; i < 30; i++)
+        frame[i] = i;
+    for (uint8_t i = 0; i < 30; i++)
+        sum += frame[i];
+    frame[30] = sum >> 8;
+    frame[31] = sum;
+
+    for (uint8_t c : frame)
+        r = decoder.push(c);
+    TEST_ASSERT_EQUAL(FRAME_DONE, r);
+    TEST_ASSERT_EQUAL(32, decoder.size());
+
+    /* longer than MaxLen */
+    frame[3] = 29;
+    for (uint8_t i = 0; i < 4; i++)
+        r = decoder.push(frame[i]);
+    TEST_ASSERT_EQUAL(FRAME_BAD_LENGTH, r);
+}
+
+int main() {
+    uint8_t frame[20];
+
+    srand(1);
+    for (int f = 0; f < FRAMES; f++) {
+        for (int i = 0; i < NOISE; i++)
+            stream.push_back(0x20 + rand() % 0x10);
+        vindriktning_frame(frame, rand() % 1000);
+        stream.insert(stream.end(), frame, frame + sizeof(frame));
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_vindriktning);
+    RUN_TEST(test_length_field);
+    RUN_TEST(test_bench);
+    return UNITY_END();
+}
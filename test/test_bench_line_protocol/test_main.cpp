@@ -0,0 +1,176 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <chrono>
+#include <new>
+#include <string>
+#include <unity.h>
+
+#include "line_protocol.h"
+
+/*
+ * Host benchmark of the line protocol writer against what publish_data()
+ * did with the InfluxDB client library. The library is not available on
+ * the host, Point is modelled with std::string the way the library builds
+ * it: tags and fields kept as strings, concatenated in toLineProtocol().
+ * Allocations are counted, times are printed only.
+ */
+
+#define ROUNDS      100000
+
+static size_t allocations;
+
+void *operator new(size_t n) {
+    void *p = malloc(n);
+
+    allocations++;
+    if (!p)
+        throw std::bad_alloc();
+
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static std::string escape_key(const std::string &s) {
+    std::string r;
+
+    r.reserve(s.length() + 5);
+    for (char c : s) {
+        if (c == ',' || c == '=' || c == ' ')
+            r += '\\';
+        r += c;
+    }
+
+    return r;
+}
+
+class Point {
+private:
+    std::string measurement, tags, fields, timestamp;
+
+public:
+    explicit Point(const std::string &m) : measurement(m) {}
+
+    void addTag(const std::string &name, const std::string &value) {
+        if (tags.length())
+            tags += ',';
+        tags += escape_key(name);
+        tags += '=';
+        tags += escape_key(value);
+    }
+
+    void addField(const std::string &name, float value) {
+        char num[32];
+
+        snprintf(num, sizeof(num), "%.2f", value);
+        if (fields.length())
+            fields += ',';
+        fields += escape_key(name);
+        fields += '=';
+        fields += num;
+    }
+
+    void setTime(uint32_t t) { timestamp = std::to_string(t); }
+
+    std::string toLineProtocol() const {
+        std::string line = measurement;
+
+        if (tags.length())
+            line += "," + tags;
+        line += " " + fields;
+        if (timestamp.length())
+            line += " " + timestamp;
+
+        return line;
+    }
+};
+
+static const float values[] = {21.456, 46.91, 1013.62};
+
+static size_t model_point(uint32_t t, std::string &out) {
+    Point p("BME280");
+
+    p.addTag("device", "Wohnzimmer");
+    p.addTag("chip_id", "0x00c0ffee");
+    p.addTag("firmware_version", "1.2.3");
+    p.addTag("tags", "air");
+    p.addField("temperature", values[0]);
+    p.addField("humidity", values[1]);
+    p.addField("pressure", values[2]);
+    p.setTime(t);
+    out = p.toLineProtocol();
+
+    return out.length() + 1;
+}
+
+static void writer_point(LineProtocol &lp, uint32_t t) {
+    lp.begin("BME280");
+    lp.tag("tags", "air");
+    lp.field("temperature", values[0]);
+    lp.field("humidity", values[1]);
+    lp.field("pressure", values[2]);
+    lp.end(t);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_same_output() {
+    LineProtocol lp;
+    std::string line;
+
+    TEST_ASSERT_TRUE(lp.alloc(LINE_PROTOCOL_POINT_SIZE));
+    lp.set_device("Wohnzimmer", "0x00c0ffee", "1.2.3");
+    writer_point(lp, 1650000000);
+    model_point(1650000000, line);
+    line += '\n';
+
+    TEST_ASSERT_EQUAL_STRING(line.c_str(), lp.c_str());
+}
+
+static void test_bench() {
+    using clock = std::chrono::steady_clock;
+    LineProtocol lp;
+    std::string line;
+    size_t bytes = 0, n;
+    double writer_ns, model_ns;
+
+    TEST_ASSERT_TRUE(lp.alloc((size_t)ROUNDS * LINE_PROTOCOL_POINT_SIZE));
+    lp.set_device("Wohnzimmer", "0x00c0ffee", "1.2.3");
+
+    n = allocations;
+    auto t0 = clock::now();
+    for (uint32_t i = 0; i < ROUNDS; i++)
+        writer_point(lp, 1650000000 + i);
+    auto t1 = clock::now();
+    TEST_ASSERT_EQUAL(0, allocations - n);
+    TEST_ASSERT_EQUAL(0, lp.get_dropped());
+    writer_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+    n = allocations;
+    t0 = clock::now();
+    for (uint32_t i = 0; i < ROUNDS; i++)
+        bytes += model_point(1650000000 + i, line);
+    t1 = clock::now();
+    model_ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+
+    TEST_ASSERT_EQUAL(bytes, lp.length());
+    printf("%zu bytes per point\n", bytes / ROUNDS);
+    printf("writer: 0 allocations, %.2f us per point\n",
+           writer_ns / ROUNDS / 1000);
+    printf("model:  %.1f allocations, %.2f us per point\n",
+           (double)(allocations - n) / ROUNDS, model_ns / ROUNDS / 1000);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_same_output);
+    RUN_TEST(test_bench);
+    return UNITY_END();
+}
@@ -0,0 +1,130 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unity.h>
+
+#include <constants.h>
+#include <sml_stream.h>
+
+using namespace esphome::sml;
+
+/*
+ * Host benchmark of the SML CRC16. The decoder updates the X.25 and Kermit
+ * registers byte by byte as bytes come in from the UART, slice-by-4 is the
+ * alternative that was considered. Times are printed only, a shared CI
+ * runner is no place to assert them.
+ */
+
+#define TELEGRAM_SIZE   400
+#define ROUNDS          20000
+
+static uint16_t slice[4][256];
+static uint8_t telegram[TELEGRAM_SIZE];
+
+static uint16_t crc_bytewise(const uint8_t *p, size_t n, uint16_t crc) {
+    for (size_t i = 0; i < n; i++)
+        crc = (crc >> 8) ^ CRC16_X25_TABLE[(crc ^ p[i]) & 0xff];
+
+    return crc;
+}
+
+static uint16_t crc_slice4(const uint8_t *p, size_t n, uint16_t crc) {
+    uint32_t v;
+
+    for (; n >= 4; p += 4, n -= 4) {
+        v = crc ^ (p[0] | p[1] << 8 | (uint32_t)p[2] << 16 |
+                   (uint32_t)p[3] << 24);
+        crc = slice[3][v & 0xff] ^ slice[2][(v >> 8) & 0xff] ^
+            slice[1][(v >> 16) & 0xff] ^ slice[0][v >> 24];
+    }
+
+    return crc_bytewise(p, n, crc);
+}
+
+template <typename F>
+static double ns_per_byte(const char *name, F f) {
+    volatile uint16_t sink = 0;
+    char msg[64];
+    double ns;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++)
+        sink = sink + f();
+    auto end = std::chrono::steady_clock::now();
+
+    ns = std::chrono::duration<double, std::nano>(end - start).count() /
+        ROUNDS / TELEGRAM_SIZE;
+    snprintf(msg, sizeof(msg), "%s: %.2f ns/byte", name, ns);
+    TEST_MESSAGE(msg);
+
+    return ns;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_slice4_matches() {
+    for (size_t n = 0; n <= 16; n++)
+        TEST_ASSERT_EQUAL_HEX16(crc_bytewise(telegram, n, 0xffff),
+                                crc_slice4(telegram, n, 0xffff));
+    TEST_ASSERT_EQUAL_HEX16(crc_bytewise(telegram, TELEGRAM_SIZE, 0xffff),
+                            crc_slice4(telegram, TELEGRAM_SIZE, 0xffff));
+}
+
+/* the decoder check, with the register values after the start sequence */
+static void test_stream_crc_matches() {
+    static const uint8_t start[] = {0x1b, 0x1b, 0x1b, 0x1b, 1, 1, 1, 1};
+    SmlCrc16 crc;
+    uint16_t x25;
+
+    crc.reset();
+    for (size_t i = 0; i < TELEGRAM_SIZE; i++)
+        crc.update(telegram[i]);
+
+    x25 = crc_bytewise(telegram, TELEGRAM_SIZE,
+                       crc_bytewise(start, sizeof(start), 0xffff)) ^ 0xffff;
+    TEST_ASSERT_EQUAL(CHECK_CRC16_X25_SUCCESS,
+                      crc.check((uint16_t)(x25 >> 8 | x25 << 8)));
+}
+
+static void test_bench() {
+    ns_per_byte("byte-wise table", [] {
+        return crc_bytewise(telegram, TELEGRAM_SIZE, 0xffff);
+    });
+    ns_per_byte("slice-by-4", [] {
+        return crc_slice4(telegram, TELEGRAM_SIZE, 0xffff);
+    });
+    ns_per_byte("SmlCrc16, X.25 and Kermit", [] {
+        SmlCrc16 crc;
+
+        crc.reset();
+        for (size_t i = 0; i < TELEGRAM_SIZE; i++)
+            crc.update(telegram[i]);
+        return (uint16_t)crc.check(0);
+    });
+}
+
+int main() {
+    srand(1);
+    for (size_t i = 0; i < TELEGRAM_SIZE; i++)
+        telegram[i] = rand();
+    for (int i = 0; i < 256; i++)
+        slice[0][i] = CRC16_X25_TABLE[i];
+    for (int k = 1; k < 4; k++) {
+        for (int i = 0; i < 256; i++)
+            slice[k][i] = (slice[k - 1][i] >> 8) ^
+                slice[0][slice[k - 1][i] & 0xff];
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_slice4_matches);
+    RUN_TEST(test_stream_crc_matches);
+    RUN_TEST(test_bench);
+    return UNITY_END();
+}
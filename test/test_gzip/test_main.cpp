@@ -0,0 +1,159 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <unity.h>
+#include <zlib.h>
+
+#include "gzip.h"
+
+/*
+ * gzip_compress() output is checked by inflating it with the zlib of the
+ * host, which also verifies the CRC and the length in the gzip trailer.
+ */
+
+/* UPLOAD_GZIP_CHUNK_SIZE, upload_queue.h needs more of the core */
+#define CHUNK_SIZE  4096
+
+static uint8_t in[GZIP_MAX_INPUT + 1];
+static uint8_t gz[GZIP_BOUND(GZIP_MAX_INPUT + 1)];
+static uint8_t out[GZIP_MAX_INPUT + 1];
+static uint32_t seed;
+
+static uint8_t random_byte() {
+    seed = seed * 1103515245 + 12345;
+
+    return seed >> 16;
+}
+
+static void fill_random(uint8_t *p, size_t len) {
+    while (len--)
+        *p++ = random_byte();
+}
+
+/* compressed size, after checking that zlib gets the input back */
+static size_t round_trip(size_t len) {
+    z_stream z = {};
+    size_t gz_len;
+
+    gz_len = gzip_compress(in, len, gz, GZIP_BOUND(len));
+    TEST_ASSERT_GREATER_THAN(0, gz_len);
+    TEST_ASSERT_LESS_OR_EQUAL(GZIP_BOUND(len), gz_len);
+
+    /* 16 + window bits accepts the gzip wrapper only */
+    TEST_ASSERT_EQUAL(Z_OK, inflateInit2(&z, 16 + MAX_WBITS));
+    z.next_in = gz;
+    z.avail_in = gz_len;
+    z.next_out = out;
+    z.avail_out = sizeof(out);
+    TEST_ASSERT_EQUAL(Z_STREAM_END, inflate(&z, Z_FINISH));
+    TEST_ASSERT_EQUAL(0, z.avail_in);
+    TEST_ASSERT_EQUAL(len, z.total_out);
+    inflateEnd(&z);
+
+    TEST_ASSERT_EQUAL_MEMORY(in, out, len);
+
+    return gz_len;
+}
+
+void setUp() {
+    seed = 1;
+}
+
+void tearDown() {}
+
+static void test_empty() {
+    /* header, end of block and the trailer */
+    TEST_ASSERT_EQUAL(20, round_trip(0));
+}
+
+static void test_one_byte() {
+    in[0] = 'x';
+    TEST_ASSERT_EQUAL(21, round_trip(1));
+    in[0] = 0xff;
+    round_trip(1);
+}
+
+/* a run is one literal and matches of 258 at distance 1 */
+static void test_long_run() {
+    memset(in, 'a', 1 + 4 * 258);
+    TEST_ASSERT_LESS_OR_EQUAL(20 + 1 + 4 * 2 + 1, round_trip(1 + 4 * 258));
+
+    /* and the lengths in between */
+    for (size_t len = 2; len < 2 * 258 + 3; len++)
+        round_trip(len);
+}
+
+/*
+ * A match may reach back 32768 bytes but not further. The hash table keeps
+ * the last position only, so the block is repeated after a run which does
+ * not hash like it.
+ */
+static void test_distance_limit() {
+    const size_t block = 64;
+    size_t gz_len[5];
+
+    for (size_t dist = 32766; dist <= 32770; dist++) {
+        seed = 1;
+        fill_random(in, block);
+        memset(in + block, 'z', dist - block);
+        memcpy(in + dist, in, block);
+        gz_len[dist - 32766] = round_trip(dist + block);
+    }
+
+    /* the block at 32768 is a match, the one a byte further is not */
+    TEST_ASSERT_LESS_THAN(gz_len[3] - block / 2, gz_len[2]);
+}
+
+/* random data does not compress, it still has to fit GZIP_BOUND */
+static void test_random() {
+    fill_random(in, GZIP_MAX_INPUT);
+    round_trip(GZIP_MAX_INPUT);
+    round_trip(1000);
+}
+
+/* line protocol as it is sent, more than one upload chunk of it */
+static void test_line_protocol() {
+    size_t len = 0, gz_len;
+    int n;
+
+    for (uint32_t i = 0; len < 3 * CHUNK_SIZE; i++) {
+        n = snprintf((char *)in + len, sizeof(in) - len,
+                     "BME280,device=Wohnzimmer,chip_id=0x00c0ffee,"
+                     "firmware_version=1.2.3,tags=air temperature=%u.%02u,"
+                     "humidity=%u.%02u,pressure=1013.%02u %u\n",
+                     21 + i % 3, (i * 7) % 100, 45 + i % 5, (i * 13) % 100,
+                     (i * 3) % 100, 1650000000 + 60 * i);
+        len += n;
+    }
+
+    gz_len = round_trip(len);
+    TEST_ASSERT_LESS_THAN(len / 4, gz_len);
+    TEST_ASSERT_LESS_THAN(CHUNK_SIZE / 4, round_trip(CHUNK_SIZE));
+}
+
+/* input that is too long or an output that is too small gives 0 */
+static void test_limits() {
+    memset(in, 'a', sizeof(in));
+    TEST_ASSERT_EQUAL(0, gzip_compress(in, GZIP_MAX_INPUT + 1, gz,
+                                       sizeof(gz)));
+
+    fill_random(in, 1000);
+    TEST_ASSERT_EQUAL(0, gzip_compress(in, 1000, gz, 500));
+    TEST_ASSERT_EQUAL(0, gzip_compress(in, 0, gz, 19));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty);
+    RUN_TEST(test_one_byte);
+    RUN_TEST(test_long_run);
+    RUN_TEST(test_distance_limit);
+    RUN_TEST(test_random);
+    RUN_TEST(test_line_protocol);
+    RUN_TEST(test_limits);
+    return UNITY_END();
+}
@@ -0,0 +1,158 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <unity.h>
+
+#include "line_protocol.h"
+
+static LineProtocol *lp;
+
+void setUp() {
+    lp = new LineProtocol();
+    TEST_ASSERT_TRUE(lp->alloc(LINE_PROTOCOL_POINT_SIZE));
+    lp->set_device("", "", "");
+}
+
+void tearDown() {
+    delete lp;
+}
+
+static void test_point() {
+    lp->set_device("kitchen", "0x00c0ffee", "1.2.3");
+    lp->begin("BME280");
+    lp->tag("tags", "air");
+    lp->field("temperature", 21.456);
+    lp->field_uint("wakes", 12);
+    lp->end(1650000000);
+
+    TEST_ASSERT_EQUAL_STRING("BME280,device=kitchen,chip_id=0x00c0ffee,"
+                             "firmware_version=1.2.3,tags=air "
+                             "temperature=21.46,wakes=12i 1650000000\n",
+                             lp->c_str());
+    TEST_ASSERT_EQUAL_UINT16(0, lp->get_dropped());
+}
+
+/* measurements escape comma and space, keys and tag values also = */
+static void test_escaping() {
+    lp->set_device("living room", "a,b", "x=y");
+    lp->begin("my meas,1");
+    lp->tag("a key", "v=1,2");
+    lp->field("f=1", 1);
+    lp->end(1);
+
+    TEST_ASSERT_EQUAL_STRING("my\\ meas\\,1,device=living\\ room,"
+                             "chip_id=a\\,b,firmware_version=x\\=y,"
+                             "a\\ key=v\\=1\\,2 f\\=1=1.00 1\n",
+                             lp->c_str());
+}
+
+/* two decimals unless asked for others, rounded half away from zero */
+static void test_decimals() {
+    lp->begin("m");
+    lp->field("a", 0.5);
+    lp->field("b", -3.14159);
+    lp->field("c", 2.999);
+    lp->field("d", 1013.25, 1);
+    lp->field("e", 7.6, 0);
+    lp->field("f", 0.001234, 5);
+    lp->field("g", -0.25);
+    lp->end(2);
+
+    TEST_ASSERT_EQUAL_STRING("m a=0.50,b=-3.14,c=3.00,d=1013.3,e=8,"
+                             "f=0.00123,g=-0.25 2\n", lp->c_str());
+}
+
+/* NaN and infinity are values that were not measured */
+static void test_missing_values() {
+    lp->begin("m");
+    lp->field("a", NAN);
+    lp->field("b", 1.5);
+    lp->field("c", INFINITY);
+    lp->end(3);
+
+    TEST_ASSERT_EQUAL_STRING("m b=1.50 3\n", lp->c_str());
+}
+
+/* an empty tag is left out, so are empty device tags */
+static void test_empty_tags() {
+    lp->set_device("", "0x1", "");
+    lp->begin("m");
+    lp->tag("tags", "");
+    lp->tag("bus", "i2c");
+    lp->field_uint("v", 0);
+    lp->end(4);
+
+    TEST_ASSERT_EQUAL_STRING("m,chip_id=0x1,bus=i2c v=0i 4\n", lp->c_str());
+}
+
+/* a point without fields is dropped */
+static void test_no_fields() {
+    lp->begin("m");
+    lp->field("a", NAN);
+    lp->end(5);
+
+    TEST_ASSERT_EQUAL_STRING("", lp->c_str());
+    TEST_ASSERT_EQUAL_UINT16(1, lp->get_dropped());
+}
+
+/* a point which does not fit is taken back, those before it stay */
+static void test_overflow() {
+    char value[64];
+
+    TEST_ASSERT_TRUE(lp->alloc(24));
+    lp->begin("m");
+    lp->field_uint("a", 1);
+    lp->end(6);
+    TEST_ASSERT_EQUAL_STRING("m a=1i 6\n", lp->c_str());
+
+    memset(value, 'x', sizeof(value) - 1);
+    value[sizeof(value) - 1] = 0;
+    lp->begin("m");
+    lp->tag("t", value);
+    lp->field_uint("b", 2);
+    lp->end(7);
+
+    /* the time stamp is what does not fit */
+    lp->begin("m");
+    lp->field_uint("c", 3);
+    lp->end(1000000000);
+
+    lp->begin("m");
+    lp->field_uint("d", 4);
+    lp->end(8);
+
+    TEST_ASSERT_EQUAL_STRING("m a=1i 6\nm d=4i 8\n", lp->c_str());
+    TEST_ASSERT_EQUAL(strlen(lp->c_str()), lp->length());
+    TEST_ASSERT_EQUAL_UINT16(2, lp->get_dropped());
+}
+
+/* device tags which do not fit the prefix are left out altogether */
+static void test_long_device() {
+    char device[LINE_PROTOCOL_PREFIX_SIZE];
+
+    memset(device, 'd', sizeof(device) - 1);
+    device[sizeof(device) - 1] = 0;
+    lp->set_device(device, "0x1", "1.0");
+    lp->begin("m");
+    lp->field_uint("v", 1);
+    lp->end(9);
+
+    TEST_ASSERT_EQUAL_STRING("m v=1i 9\n", lp->c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_point);
+    RUN_TEST(test_escaping);
+    RUN_TEST(test_decimals);
+    RUN_TEST(test_missing_values);
+    RUN_TEST(test_empty_tags);
+    RUN_TEST(test_no_fields);
+    RUN_TEST(test_overflow);
+    RUN_TEST(test_long_device);
+    return UNITY_END();
+}
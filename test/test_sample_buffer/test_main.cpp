@@ -0,0 +1,192 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <unity.h>
+
+#include "rtcmem.h"
+#include "sample_buffer.h"
+
+#define WORDS       32
+
+struct sample {
+    uint8_t sensor;
+    uint8_t point;
+    uint8_t mask;
+    uint8_t count;
+    uint32_t time_s;
+    int32_t values[SAMPLE_BUFFER_MAX_VALUES];
+};
+
+/* sum of the sleep times, the wakes take no time to keep the ages exact */
+static uint32_t clock_s;
+
+/* add one wake worth of samples on a freshly set up buffer */
+static bool wake(const struct sample *s, uint8_t n, uint32_t sleep_s) {
+    SampleBuffer buffer;
+    bool ok = true;
+
+    native_millis = 0;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    for (uint8_t i = 0; i < n && ok; i++)
+        ok = buffer.add(s[i].sensor, s[i].point, s[i].values, s[i].mask,
+                        s[i].count);
+    buffer.sleep(sleep_s);
+    clock_s += sleep_s;
+
+    return ok;
+}
+
+static void check(const struct sample *s, uint8_t n) {
+    SampleBuffer buffer;
+    struct sample_entry e;
+    uint8_t i = 0;
+
+    native_millis = 100;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    TEST_ASSERT_EQUAL_UINT16(n, buffer.get_num_entries());
+
+    buffer.rewind();
+    for (; buffer.next(e); i++) {
+        TEST_ASSERT_LESS_THAN_UINT8(n, i);
+        TEST_ASSERT_EQUAL_UINT8(s[i].sensor, e.sensor);
+        TEST_ASSERT_EQUAL_UINT8(s[i].point, e.point);
+        TEST_ASSERT_EQUAL_UINT8(s[i].count, e.count);
+        TEST_ASSERT_EQUAL_HEX8(s[i].mask, e.mask);
+        TEST_ASSERT_EQUAL_UINT32(clock_s - s[i].time_s, e.age_s);
+        for (uint8_t j = 0; j < e.count; j++) {
+            if (e.mask & (1 << j))
+                TEST_ASSERT_EQUAL_INT32(s[i].values[j], e.values[j]);
+            else
+                TEST_ASSERT_EQUAL_INT32(0, e.values[j]);
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT8(n, i);
+}
+
+void setUp() {
+    memset(rtcmem.get(RTCMEM_TAG_SAMPLES, 0), 0xa5,
+           RTCMEM_WORDS * sizeof(uint32_t));
+    native_millis = 0;
+    clock_s = 0;
+
+    /* whatever was in RTC memory is thrown away */
+    SampleBuffer buffer;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    buffer.clear();
+    TEST_ASSERT_EQUAL_UINT16(0, buffer.get_used());
+}
+
+void tearDown() {}
+
+static void test_round_trip() {
+    struct sample s[] = {
+        {0, 0, 0x07, 3, 0, {2150, 101325, 4500}},
+        {1, 0, 0x03, 2, 0, {-125, 7}},
+        {0, 0, 0x07, 3, 60, {2153, 101318, 4490}},
+        {1, 0, 0x03, 2, 60, {-130, 7}},
+        {0, 0, 0x07, 3, 120, {2149, 101322, 4510}},
+        {1, 0, 0x03, 2, 120, {-120, 8}},
+    };
+
+    for (uint8_t i = 0; i < 6; i += 2)
+        TEST_ASSERT_TRUE(wake(s + i, 2, 60));
+    check(s, 6);
+}
+
+/* differences of the extremes wrap around, they have to come back */
+static void test_zigzag_extremes() {
+    struct sample s[] = {
+        {2, 0, 0x0f, 4, 0, {INT32_MIN, INT32_MAX, 0, -1}},
+        {2, 0, 0x0f, 4, 60, {INT32_MAX, INT32_MIN, -1, 0}},
+        {2, 0, 0x0f, 4, 120, {INT32_MIN, INT32_MIN, INT32_MAX, INT32_MAX}},
+        {2, 0, 0x0f, 4, 180, {0, 1, -1, INT32_MIN + 1}},
+    };
+
+    for (uint8_t i = 0; i < 4; i++)
+        TEST_ASSERT_TRUE(wake(s + i, 1, 60));
+    check(s, 4);
+}
+
+/* NaN is not stored, the field is missing from the mask */
+static void test_masked_fields() {
+    struct sample s[] = {
+        {3, 0, 0x05, 3, 0, {10, 0, 30}},
+        {3, 0, 0x02, 3, 60, {0, 2000, 0}},
+        {3, 0, 0x07, 3, 120, {12, 1990, 29}},
+        {3, 0, 0x00, 3, 180, {0, 0, 0}},
+        {3, 0, 0x04, 3, 240, {0, 0, -31}},
+    };
+
+    for (uint8_t i = 0; i < 5; i++)
+        TEST_ASSERT_TRUE(wake(s + i, 1, 60));
+    check(s, 5);
+}
+
+/* a different sleep time once there was something to upload */
+static void test_interval_changes() {
+    static const uint32_t sleep_s[] = {60, 60, 300, 30, 30, 3600, 1, 60};
+    struct sample s[8];
+
+    for (uint8_t i = 0; i < 8; i++) {
+        s[i] = {4, 1, 0x01, 1, clock_s, {1000 + i}};
+        TEST_ASSERT_TRUE(wake(s + i, 1, sleep_s[i]));
+    }
+    check(s, 8);
+}
+
+/* a sample which does not fit leaves the buffer as it was */
+static void test_buffer_full() {
+    struct sample s[WORDS * 4];
+    uint16_t used = 0;
+    uint8_t n;
+
+    for (n = 0; n < WORDS * 4; n++) {
+        s[n] = {5, 0, 0x03, 2, clock_s, {n * 1000, -n * 100000}};
+        if (!wake(s + n, 1, 60))
+            break;
+        SampleBuffer buffer;
+        TEST_ASSERT_TRUE(buffer.begin(WORDS));
+        TEST_ASSERT_GREATER_THAN_UINT16(used, buffer.get_used());
+        used = buffer.get_used();
+    }
+    TEST_ASSERT_LESS_THAN_UINT8(WORDS * 4, n);
+    TEST_ASSERT_GREATER_THAN_UINT8(1, n);
+
+    SampleBuffer buffer;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    TEST_ASSERT_EQUAL_UINT16(used, buffer.get_used());
+    check(s, n);
+}
+
+/* the stream is checked on every wake, garbage starts over */
+static void test_corrupt_stream() {
+    struct sample s[] = {
+        {0, 0, 0x01, 1, 0, {1}},
+        {0, 0, 0x01, 1, 0, {2}},
+    };
+    struct sample_buffer_header *hdr =
+        (struct sample_buffer_header *)rtcmem.get(RTCMEM_TAG_SAMPLES, 0);
+
+    TEST_ASSERT_TRUE(wake(s, 2, 60));
+    hdr->entries++;
+
+    SampleBuffer buffer;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    TEST_ASSERT_EQUAL_UINT16(0, buffer.get_num_entries());
+    TEST_ASSERT_EQUAL_UINT16(0, buffer.get_used());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_zigzag_extremes);
+    RUN_TEST(test_masked_fields);
+    RUN_TEST(test_interval_changes);
+    RUN_TEST(test_buffer_full);
+    RUN_TEST(test_corrupt_stream);
+    return UNITY_END();
+}
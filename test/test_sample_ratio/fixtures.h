@@ -0,0 +1,386 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#ifndef _FIXTURES_H_
+#define _FIXTURES_H_
+
+/*
+ * Three hours at one sample a minute, rounded to what the sensors report.
+ * These are not recordings from a device. No recordings were available, so
+ * the series are modelled on one: slow drift plus sensor noise for the
+ * BME280, with a window opened after 100 minutes. The meter has a base
+ * load, a fridge cycling every 40 minutes and two large consumers.
+ */
+
+/* BME280 indoors: temperature C, humidity %, pressure hPa */
+static const float bme280_series[][3] = {
+    {21.41, 46.91, 1013.63},
+    {21.39, 46.87, 1013.62},
+    {21.41, 46.93, 1013.59},
+    {21.41, 46.87, 1013.61},
+    {21.40, 46.89, 1013.63},
+    {21.42, 46.93, 1013.59},
+    {21.43, 46.94, 1013.58},
+    {21.42, 46.93, 1013.59},
+    {21.47, 46.93, 1013.58},
+    {21.46, 46.94, 1013.57},
+    {21.45, 46.97, 1013.56},
+    {21.44, 46.96, 1013.59},
+    {21.46, 46.97, 1013.58},
+    {21.46, 46.96, 1013.58},
+    {21.48, 46.99, 1013.58},
+    {21.49, 46.97, 1013.57},
+    {21.50, 46.99, 1013.55},
+    {21.49, 46.95, 1013.55},
+    {21.50, 46.96, 1013.56},
+    {21.50, 47.00, 1013.53},
+    {21.49, 46.93, 1013.55},
+    {21.54, 46.98, 1013.54},
+    {21.54, 46.98, 1013.55},
+    {21.52, 47.01, 1013.54},
+    {21.53, 47.01, 1013.53},
+    {21.55, 46.99, 1013.49},
+    {21.56, 47.01, 1013.53},
+    {21.56, 47.01, 1013.52},
+    {21.56, 47.00, 1013.50},
+    {21.58, 46.99, 1013.50},
+    {21.57, 46.93, 1013.49},
+    {21.56, 46.91, 1013.50},
+    {21.58, 47.02, 1013.50},
+    {21.59, 46.99, 1013.51},
+    {21.57, 46.98, 1013.48},
+    {21.61, 46.93, 1013.48},
+    {21.58, 46.98, 1013.48},
+    {21.61, 46.99, 1013.48},
+    {21.60, 46.99, 1013.49},
+    {21.61, 47.00, 1013.45},
+    {21.63, 46.92, 1013.46},
+    {21.65, 46.92, 1013.45},
+    {21.64, 46.96, 1013.44},
+    {21.62, 46.93, 1013.44},
+    {21.65, 46.90, 1013.44},
+    {21.65, 46.92, 1013.44},
+    {21.64, 46.92, 1013.44},
+    {21.65, 46.95, 1013.42},
+    {21.66, 46.92, 1013.43},
+    {21.66, 46.85, 1013.42},
+    {21.67, 46.90, 1013.41},
+    {21.68, 46.90, 1013.42},
+    {21.67, 46.89, 1013.39},
+    {21.66, 46.83, 1013.40},
+    {21.66, 46.84, 1013.40},
+    {21.67, 46.83, 1013.39},
+    {21.70, 46.79, 1013.40},
+    {21.68, 46.83, 1013.40},
+    {21.70, 46.82, 1013.38},
+    {21.67, 46.75, 1013.40},
+    {21.69, 46.77, 1013.38},
+    {21.70, 46.75, 1013.36},
+    {21.71, 46.83, 1013.36},
+    {21.72, 46.78, 1013.38},
+    {21.70, 46.75, 1013.38},
+    {21.72, 46.72, 1013.33},
+    {21.69, 46.75, 1013.37},
+    {21.72, 46.65, 1013.35},
+    {21.70, 46.68, 1013.34},
+    {21.73, 46.69, 1013.34},
+    {21.73, 46.61, 1013.34},
+    {21.72, 46.61, 1013.34},
+    {21.73, 46.57, 1013.33},
+    {21.74, 46.57, 1013.33},
+    {21.74, 46.56, 1013.34},
+    {21.74, 46.61, 1013.33},
+    {21.73, 46.56, 1013.33},
+    {21.73, 46.50, 1013.31},
+    {21.73, 46.54, 1013.29},
+    {21.74, 46.47, 1013.31},
+    {21.74, 46.46, 1013.28},
+    {21.75, 46.52, 1013.30},
+    {21.75, 46.49, 1013.30},
+    {21.75, 46.44, 1013.28},
+    {21.75, 46.45, 1013.29},
+    {21.75, 46.37, 1013.29},
+    {21.76, 46.35, 1013.29},
+    {21.76, 46.35, 1013.26},
+    {21.75, 46.33, 1013.27},
+    {21.72, 46.36, 1013.28},
+    {21.75, 46.33, 1013.28},
+    {21.76, 46.28, 1013.26},
+    {21.74, 46.22, 1013.26},
+    {21.74, 46.26, 1013.23},
+    {21.74, 46.26, 1013.25},
+    {21.75, 46.21, 1013.26},
+    {21.76, 46.17, 1013.22},
+    {21.74, 46.16, 1013.23},
+    {21.74, 46.16, 1013.22},
+    {21.75, 46.15, 1013.25},
+    {21.74, 46.09, 1013.21},
+    {21.63, 46.52, 1013.23},
+    {21.52, 46.90, 1013.23},
+    {21.40, 47.27, 1013.20},
+    {21.25, 47.65, 1013.21},
+    {21.16, 48.05, 1013.20},
+    {21.05, 48.45, 1013.20},
+    {20.89, 48.84, 1013.21},
+    {20.78, 49.18, 1013.19},
+    {20.66, 49.62, 1013.18},
+    {20.55, 49.96, 1013.16},
+    {20.43, 50.33, 1013.16},
+    {20.31, 50.73, 1013.17},
+    {20.18, 51.06, 1013.15},
+    {20.05, 51.49, 1013.17},
+    {19.92, 51.91, 1013.16},
+    {20.01, 51.33, 1013.13},
+    {20.11, 50.91, 1013.16},
+    {20.16, 50.49, 1013.15},
+    {20.24, 50.12, 1013.12},
+    {20.30, 49.78, 1013.13},
+    {20.38, 49.41, 1013.13},
+    {20.46, 49.14, 1013.13},
+    {20.52, 48.82, 1013.13},
+    {20.57, 48.63, 1013.15},
+    {20.63, 48.34, 1013.10},
+    {20.66, 48.12, 1013.10},
+    {20.70, 47.86, 1013.09},
+    {20.78, 47.70, 1013.13},
+    {20.79, 47.55, 1013.10},
+    {20.83, 47.38, 1013.11},
+    {20.87, 47.18, 1013.08},
+    {20.92, 47.14, 1013.11},
+    {20.93, 46.92, 1013.07},
+    {20.94, 46.84, 1013.08},
+    {21.00, 46.69, 1013.08},
+    {21.03, 46.60, 1013.09},
+    {21.05, 46.58, 1013.07},
+    {21.10, 46.44, 1013.05},
+    {21.13, 46.38, 1013.06},
+    {21.16, 46.29, 1013.06},
+    {21.14, 46.22, 1013.08},
+    {21.17, 46.15, 1013.05},
+    {21.21, 46.05, 1013.04},
+    {21.20, 46.05, 1013.02},
+    {21.23, 45.94, 1013.05},
+    {21.26, 45.88, 1013.04},
+    {21.24, 45.92, 1013.01},
+    {21.29, 45.80, 1013.02},
+    {21.30, 45.85, 1013.03},
+    {21.32, 45.73, 1013.00},
+    {21.31, 45.74, 1013.01},
+    {21.30, 45.72, 1013.00},
+    {21.34, 45.70, 1013.01},
+    {21.34, 45.70, 1012.99},
+    {21.36, 45.64, 1012.97},
+    {21.35, 45.69, 1012.98},
+    {21.34, 45.59, 1013.00},
+    {21.38, 45.59, 1012.97},
+    {21.36, 45.57, 1012.98},
+    {21.38, 45.54, 1012.95},
+    {21.36, 45.51, 1012.97},
+    {21.37, 45.49, 1012.94},
+    {21.37, 45.54, 1012.96},
+    {21.37, 45.53, 1012.96},
+    {21.39, 45.52, 1012.95},
+    {21.38, 45.45, 1012.95},
+    {21.39, 45.45, 1012.94},
+    {21.39, 45.45, 1012.95},
+    {21.41, 45.50, 1012.95},
+    {21.42, 45.46, 1012.95},
+    {21.40, 45.48, 1012.94},
+    {21.37, 45.45, 1012.94},
+    {21.41, 45.40, 1012.94},
+    {21.40, 45.52, 1012.93},
+    {21.38, 45.47, 1012.91},
+    {21.38, 45.48, 1012.90},
+    {21.39, 45.43, 1012.89},
+    {21.39, 45.45, 1012.92},
+    {21.39, 45.47, 1012.92},
+};
+
+/* SML meter: energy 1.8.0 kWh, power 16.7.0 W */
+static const float sml_series[][2] = {
+    {15238.422, 275.0},
+    {15238.426, 269.0},
+    {15238.431, 277.0},
+    {15238.435, 276.0},
+    {15238.440, 274.0},
+    {15238.445, 281.0},
+    {15238.449, 277.0},
+    {15238.454, 275.0},
+    {15238.458, 273.0},
+    {15238.463, 272.0},
+    {15238.467, 271.0},
+    {15238.472, 280.0},
+    {15238.477, 271.0},
+    {15238.481, 273.0},
+    {15238.486, 269.0},
+    {15238.490, 280.0},
+    {15238.495, 271.0},
+    {15238.499, 271.0},
+    {15238.504, 275.0},
+    {15238.508, 269.0},
+    {15238.513, 280.0},
+    {15238.517, 270.0},
+    {15238.522, 280.0},
+    {15238.527, 275.0},
+    {15238.531, 281.0},
+    {15238.536, 272.0},
+    {15238.540, 270.0},
+    {15238.545, 275.0},
+    {15238.550, 275.0},
+    {15238.554, 270.0},
+    {15238.559, 281.0},
+    {15238.563, 278.0},
+    {15238.568, 271.0},
+    {15238.573, 277.0},
+    {15238.577, 274.0},
+    {15238.582, 276.0},
+    {15238.586, 279.0},
+    {15238.591, 278.0},
+    {15238.596, 281.0},
+    {15238.600, 279.0},
+    {15238.603, 177.0},
+    {15238.606, 182.0},
+    {15238.609, 174.0},
+    {15238.612, 178.0},
+    {15238.615, 182.0},
+    {15238.618, 176.0},
+    {15238.621, 184.0},
+    {15238.624, 182.0},
+    {15238.627, 179.0},
+    {15238.630, 183.0},
+    {15238.633, 180.0},
+    {15238.636, 178.0},
+    {15238.639, 178.0},
+    {15238.642, 186.0},
+    {15238.645, 180.0},
+    {15238.648, 181.0},
+    {15238.651, 185.0},
+    {15238.654, 176.0},
+    {15238.657, 176.0},
+    {15238.660, 176.0},
+    {15238.697, 2186.0},
+    {15238.733, 2178.0},
+    {15238.769, 2186.0},
+    {15238.806, 2177.0},
+    {15238.842, 2180.0},
+    {15238.878, 2178.0},
+    {15238.915, 2180.0},
+    {15238.951, 2176.0},
+    {15238.987, 2180.0},
+    {15239.023, 2174.0},
+    {15239.060, 2180.0},
+    {15239.096, 2181.0},
+    {15239.099, 174.0},
+    {15239.102, 185.0},
+    {15239.105, 178.0},
+    {15239.108, 180.0},
+    {15239.111, 179.0},
+    {15239.114, 181.0},
+    {15239.117, 181.0},
+    {15239.120, 184.0},
+    {15239.125, 280.0},
+    {15239.130, 280.0},
+    {15239.134, 277.0},
+    {15239.139, 278.0},
+    {15239.143, 273.0},
+    {15239.148, 278.0},
+    {15239.153, 277.0},
+    {15239.157, 276.0},
+    {15239.162, 270.0},
+    {15239.166, 279.0},
+    {15239.171, 277.0},
+    {15239.176, 274.0},
+    {15239.180, 281.0},
+    {15239.185, 279.0},
+    {15239.189, 270.0},
+    {15239.194, 281.0},
+    {15239.199, 273.0},
+    {15239.203, 277.0},
+    {15239.208, 272.0},
+    {15239.212, 273.0},
+    {15239.217, 276.0},
+    {15239.221, 275.0},
+    {15239.226, 278.0},
+    {15239.231, 275.0},
+    {15239.235, 278.0},
+    {15239.240, 273.0},
+    {15239.245, 280.0},
+    {15239.249, 278.0},
+    {15239.254, 269.0},
+    {15239.258, 275.0},
+    {15239.263, 277.0},
+    {15239.268, 281.0},
+    {15239.272, 281.0},
+    {15239.277, 275.0},
+    {15239.281, 278.0},
+    {15239.286, 277.0},
+    {15239.291, 279.0},
+    {15239.295, 269.0},
+    {15239.300, 277.0},
+    {15239.304, 281.0},
+    {15239.307, 179.0},
+    {15239.310, 175.0},
+    {15239.313, 182.0},
+    {15239.316, 185.0},
+    {15239.319, 180.0},
+    {15239.322, 174.0},
+    {15239.325, 180.0},
+    {15239.328, 182.0},
+    {15239.331, 178.0},
+    {15239.334, 180.0},
+    {15239.348, 826.0},
+    {15239.362, 824.0},
+    {15239.376, 831.0},
+    {15239.390, 836.0},
+    {15239.403, 829.0},
+    {15239.417, 828.0},
+    {15239.431, 828.0},
+    {15239.445, 835.0},
+    {15239.459, 828.0},
+    {15239.473, 825.0},
+    {15239.486, 832.0},
+    {15239.500, 836.0},
+    {15239.514, 824.0},
+    {15239.528, 834.0},
+    {15239.542, 827.0},
+    {15239.556, 830.0},
+    {15239.569, 831.0},
+    {15239.583, 827.0},
+    {15239.597, 834.0},
+    {15239.611, 831.0},
+    {15239.614, 180.0},
+    {15239.617, 186.0},
+    {15239.620, 178.0},
+    {15239.623, 180.0},
+    {15239.626, 178.0},
+    {15239.629, 175.0},
+    {15239.632, 185.0},
+    {15239.635, 176.0},
+    {15239.638, 178.0},
+    {15239.641, 182.0},
+    {15239.646, 277.0},
+    {15239.650, 270.0},
+    {15239.655, 276.0},
+    {15239.659, 272.0},
+    {15239.664, 271.0},
+    {15239.668, 272.0},
+    {15239.673, 271.0},
+    {15239.677, 270.0},
+    {15239.682, 278.0},
+    {15239.686, 274.0},
+    {15239.691, 270.0},
+    {15239.696, 280.0},
+    {15239.700, 273.0},
+    {15239.705, 278.0},
+    {15239.709, 270.0},
+    {15239.714, 272.0},
+    {15239.718, 275.0},
+    {15239.723, 274.0},
+    {15239.728, 270.0},
+    {15239.732, 270.0},
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * (C) Copyright 2022 Tillmann Heidsieck
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ */
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <unity.h>
+
+#include "rtcmem.h"
+#include "sample_buffer.h"
+
+#include "fixtures.h"
+
+/*
+ * Compression ratio of the sample buffer on the series in fixtures.h. The
+ * reference is what a sample took before the buffer existed: a float per
+ * field and a 32 bit word for the time.
+ */
+
+/* sample_buffer_words of misc/templates/mapping.json.tmpl */
+#define WORDS       72
+#define SLEEP_S     60
+
+/* what the codec achieves on the fixtures, less a little */
+#define RATIO_BME280    2.5
+#define RATIO_SML       2.0
+
+#define ARRAY_SIZE(a)   (sizeof(a) / sizeof((a)[0]))
+
+struct series {
+    const float *values;
+    uint8_t fields;
+    size_t count;
+    const float *resolution;
+};
+
+static int32_t quantised[200][SAMPLE_BUFFER_MAX_VALUES];
+
+static int32_t quantise(float v, float res) {
+    return lround((double)v / res);
+}
+
+/* one sample per wake until the buffer is full, returns the ratio */
+static float fill(const struct series &s) {
+    uint8_t mask = (1 << s.fields) - 1;
+    struct sample_entry e;
+    uint16_t used;
+    size_t n;
+
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(ARRAY_SIZE(quantised), s.count);
+
+    for (n = 0; n < s.count; n++) {
+        SampleBuffer buffer;
+
+        for (uint8_t j = 0; j < s.fields; j++)
+            quantised[n][j] = quantise(s.values[n * s.fields + j],
+                                       s.resolution[j]);
+
+        TEST_ASSERT_TRUE(buffer.begin(WORDS));
+        if (!buffer.add(0, 0, quantised[n], mask, s.fields))
+            break;
+        buffer.sleep(SLEEP_S);
+    }
+
+    /* everything that went in comes out again */
+    SampleBuffer buffer;
+    size_t i = 0;
+
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    TEST_ASSERT_EQUAL_UINT16(n, buffer.get_num_entries());
+    buffer.rewind();
+    for (; buffer.next(e); i++) {
+        TEST_ASSERT_EQUAL_UINT8(s.fields, e.count);
+        TEST_ASSERT_EQUAL_UINT32((n - i) * SLEEP_S, e.age_s);
+        for (uint8_t j = 0; j < s.fields; j++)
+            TEST_ASSERT_EQUAL_INT32(quantised[i][j], e.values[j]);
+    }
+    TEST_ASSERT_EQUAL(n, i);
+
+    used = buffer.get_used();
+    printf("%zu of %zu samples in %u bytes, %.1f bytes per sample, "
+           "ratio %.1f\n", n, s.count, used, (float)used / n,
+           (float)n * (1 + s.fields) * sizeof(float) / used);
+
+    return (float)n * (1 + s.fields) * sizeof(float) / used;
+}
+
+void setUp() {
+    native_millis = 0;
+
+    SampleBuffer buffer;
+    TEST_ASSERT_TRUE(buffer.begin(WORDS));
+    buffer.clear();
+}
+
+void tearDown() {}
+
+static void test_bme280() {
+    static const float res[] = {0.01, 0.01, 0.01};
+    struct series s = {
+        bme280_series[0], 3, ARRAY_SIZE(bme280_series), res
+    };
+
+    TEST_ASSERT_TRUE(fill(s) >= RATIO_BME280);
+}
+
+static void test_sml() {
+    static const float res[] = {0.001, 0.1};
+    struct series s = {
+        sml_series[0], 2, ARRAY_SIZE(sml_series), res
+    };
+
+    TEST_ASSERT_TRUE(fill(s) >= RATIO_SML);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bme280);
+    RUN_TEST(test_sml);
+    return UNITY_END();
+}